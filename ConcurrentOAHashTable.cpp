@@ -0,0 +1,190 @@
+#pragma once
+
+#include "ConcurrentOAHashTable.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::ConcurrentOAHashTable(
+  const OAHTConfig& config,
+  u32 shards
+):
+    hasher{Table::make_hasher(config)} {
+  OAHTConfig shard_config{config};
+  shard_config.InitialTableSize_ = std::max(
+    config.InitialTableSize_ / std::max(shards, 1u),
+    1u
+  );
+
+  shard_list.reserve(std::max(shards, 1u));
+  for (u32 i = 0; i < std::max(shards, 1u); i++) {
+    shard_list.emplace_back(new Shard{shard_config});
+  }
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::insert(
+  const char* key,
+  const T& data
+) -> void {
+  emplace(key, data);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::insert(
+  const char* key,
+  T&& data
+) -> void {
+  emplace(key, std::move(data));
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+template<typename... Args>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::emplace(
+  const char* key,
+  Args&&... args
+) -> void {
+  Shard& shard = shard_of(key);
+  std::lock_guard<std::mutex> guard{shard.lock};
+
+  shard.table.emplace(key, std::forward<Args>(args)...);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_insert(
+  const char* key,
+  const T& data
+) -> OAHTStatus {
+  return try_emplace(key, data);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_insert(
+  const char* key,
+  T&& data
+) -> OAHTStatus {
+  return try_emplace(key, std::move(data));
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+template<typename... Args>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_emplace(
+  const char* key,
+  Args&&... args
+) -> OAHTStatus {
+  Shard& shard = shard_of(key);
+  std::lock_guard<std::mutex> guard{shard.lock};
+
+  return shard.table.try_emplace(key, std::forward<Args>(args)...);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::remove(
+  const char* key
+) -> void {
+  Shard& shard = shard_of(key);
+  std::lock_guard<std::mutex> guard{shard.lock};
+
+  shard.table.remove(key);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_remove(
+  const char* key
+) -> OAHTStatus {
+  Shard& shard = shard_of(key);
+  std::lock_guard<std::mutex> guard{shard.lock};
+
+  return shard.table.try_remove(key);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::find(
+  const char* key
+) const -> T {
+  const Shard& shard = shard_of(key);
+  std::lock_guard<std::mutex> guard{shard.lock};
+
+  return shard.table.find(key);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_find(
+  const char* key,
+  T& data
+) const -> OAHTStatus {
+  const Shard& shard = shard_of(key);
+  std::lock_guard<std::mutex> guard{shard.lock};
+
+  const T* found = shard.table.try_find(key);
+
+  if (not found) {
+    return S_ITEM_NOT_FOUND;
+  }
+
+  data = *found;
+  return S_OK;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::clear() -> void {
+  for (const auto& shard : shard_list) {
+    std::lock_guard<std::mutex> guard{shard->lock};
+    shard->table.clear();
+  }
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::GetStats() const
+  -> OAHTStats {
+  OAHTStats total{};
+
+  for (const auto& shard : shard_list) {
+    std::lock_guard<std::mutex> guard{shard->lock};
+    const OAHTStats stats = shard->table.GetStats();
+
+    total.Count_ += stats.Count_;
+    total.TableSize_ += stats.TableSize_;
+    total.Probes_ += stats.Probes_;
+    total.Expansions_ += stats.Expansions_;
+    total.Tombstones_ += stats.Tombstones_;
+    total.Purges_ += stats.Purges_;
+    total.PrimaryHashFunc_ = stats.PrimaryHashFunc_;
+    total.SecondaryHashFunc_ = stats.SecondaryHashFunc_;
+  }
+
+  return total;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::size() const
+  -> u32 {
+  return GetStats().Count_;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::shards() const
+  -> u32 {
+  return static_cast<u32>(shard_list.size());
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>::shard_of(
+  const char* key
+) const -> Shard& {
+  u64 hash;
+
+  if (not std::is_same<KeyEqual, OAHTKeyEqual>::value) {
+    // only the hasher knows which keys compare equal, mix its full hash
+    hash = hasher.primary(key, FULL_HASH_RANGE) * 0x9E3779B97F4A7C15ull;
+  } else {
+    hash = FastHash64(key, std::strlen(key), SHARD_SEED);
+  }
+
+  // (high half * shards) / 2^32, any shard count works
+  return *shard_list[
+    static_cast<usize>(((hash >> 32) * shard_list.size()) >> 32)
+  ];
+}
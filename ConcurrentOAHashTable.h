@@ -0,0 +1,100 @@
+//---------------------------------------------------------------------------
+#ifndef CONCURRENTOAHASHTABLEH
+#define CONCURRENTOAHASHTABLEH
+//---------------------------------------------------------------------------
+
+#include "OAHashTable.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Shards used by a ConcurrentOAHashTable unless told otherwise
+ */
+const u32 DEFAULT_SHARDS = 64;
+
+/**
+ * @brief Seed of the hash that picks a shard. The tables inside index their
+ * slots with the same hash bits a shard would be picked by, so shards hash
+ * with a seed of their own to keep every slot of every table in use
+ */
+const std::uint64_t SHARD_SEED = 0x5D588B656C078965ull;
+
+//! Thread safe hash table, keys are spread over independently locked
+//! OAHashTable shards by the high bits of their hash, so threads only wait
+//! for each other when they touch the same shard.
+//! Every operation (find too, it counts probes) locks its shard, and data is
+//! handed out by copy since a reference would outlive the lock
+template<
+  typename T,
+  usize KeyCapacity = MAX_KEYLEN,
+  typename Hasher = OAHTFunctionHasher,
+  typename KeyEqual = OAHTKeyEqual>
+class ConcurrentOAHashTable {
+public:
+
+  using Table = OAHashTable<T, KeyCapacity, Hasher, KeyEqual>;
+  using OAHTConfig = typename Table::OAHTConfig;
+
+  // Every shard gets config, with InitialTableSize_ split between them
+  ConcurrentOAHashTable(const OAHTConfig& config, u32 shards = DEFAULT_SHARDS);
+
+  // The same as in OAHashTable, each locks only the shard of key
+  auto insert(const char* key, const T& data) -> void;
+
+  auto insert(const char* key, T&& data) -> void;
+
+  template<typename... Args>
+  auto emplace(const char* key, Args&&... args) -> void;
+
+  auto try_insert(const char* key, const T& data) -> OAHTStatus;
+
+  auto try_insert(const char* key, T&& data) -> OAHTStatus;
+
+  template<typename... Args>
+  auto try_emplace(const char* key, Args&&... args) -> OAHTStatus;
+
+  auto remove(const char* key) -> void;
+
+  auto try_remove(const char* key) -> OAHTStatus;
+
+  // A copy of the data of key. Throws an exception (E_ITEM_NOT_FOUND) if
+  // not found
+  auto find(const char* key) const -> T;
+
+  // Copies the data of key into data, or returns S_ITEM_NOT_FOUND and
+  // leaves it alone
+  auto try_find(const char* key, T& data) const -> OAHTStatus;
+
+  // Empties every shard, one after the other
+  auto clear() -> void;
+
+  // Stats of all shards added up. Shards are locked one at a time, so the
+  // sum is not a snapshot while other threads are writing
+  auto GetStats() const -> OAHTStats;
+
+  auto size() const -> u32;
+
+  auto shards() const -> u32;
+
+private:
+
+  struct Shard {
+    explicit Shard(const OAHTConfig& config): table{config} {}
+
+    mutable std::mutex lock;
+    Table table;
+  };
+
+  // Kept apart on the heap, so the locks of neighbouring shards don't share
+  // a cache line
+  std::vector<std::unique_ptr<Shard>> shard_list;
+  Hasher hasher;
+
+  auto shard_of(const char* key) const -> Shard&;
+};
+
+#include "ConcurrentOAHashTable.cpp"
+
+#endif
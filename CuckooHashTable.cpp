@@ -0,0 +1,606 @@
+#pragma once
+
+#include "CuckooHashTable.h"
+#include "FastHash.h"
+#include "HugePages.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <new>
+#include <utility>
+
+template<typename T>
+CuckooHashTable<T>::CuckooHashTable(const OAHTConfig& config):
+    config{config},
+    table{make_array(std::max(
+      (config.InitialTableSize_ + CUCKOO_BUCKET_SLOTS - 1)
+        / CUCKOO_BUCKET_SLOTS,
+      u32{1}
+    ))} {
+  stats.TableSize_ = capacity();
+  stats.PrimaryHashFunc_ = config.PrimaryHashFunc_;
+  stats.SecondaryHashFunc_ = config.SecondaryHashFunc_;
+}
+
+template<typename T>
+CuckooHashTable<T>::~CuckooHashTable() {
+  clear();
+}
+
+template<typename T>
+auto CuckooHashTable<T>::insert(const char* key, const T& data) -> void {
+  emplace(key, data);
+}
+
+template<typename T>
+auto CuckooHashTable<T>::insert(const char* key, T&& data) -> void {
+  emplace(key, std::move(data));
+}
+
+template<typename T>
+template<typename... Args>
+auto CuckooHashTable<T>::emplace(const char* key, Args&&... args) -> void {
+  if (try_emplace(key, std::forward<Args>(args)...) == S_DUPLICATE) {
+    throw OAHashTableException(
+      OAHashTableException::E_DUPLICATE,
+      "Duplicate key"
+    );
+  }
+}
+
+template<typename T>
+auto CuckooHashTable<T>::try_insert(const char* key, const T& data)
+  -> OAHTStatus {
+  return try_emplace(key, data);
+}
+
+template<typename T>
+auto CuckooHashTable<T>::try_insert(const char* key, T&& data)
+  -> OAHTStatus {
+  return try_emplace(key, std::move(data));
+}
+
+template<typename T>
+template<typename... Args>
+auto CuckooHashTable<T>::try_emplace(const char* key, Args&&... args)
+  -> OAHTStatus {
+  const u64 seeded = seed;
+  const Hashes hashes = hash(key);
+
+  if (lookup(key, hashes)) {
+    return S_DUPLICATE;
+  }
+
+  grow(false);
+
+  // growing may have moved the table to a new seed
+  Node* node = make_node(
+    key,
+    seed == seeded ? hashes : hash(key),
+    std::forward<Args>(args)...
+  );
+
+  try {
+    while (not place(table, node)) {
+      const u64 before = seed;
+
+      // a table too empty to grow keeps the item in its stash, and hashes
+      // the keys apart once that is full
+      if (not grow(true)) {
+        if (stash(table, node)) {
+          break;
+        }
+        resize(table.Count, next_seed(seed));
+      }
+
+      if (seed != before) {
+        const Hashes rehashed = hash(node->key());
+        node->Primary = rehashed.Primary;
+        node->Secondary = rehashed.Secondary;
+      }
+    }
+  } catch (...) {
+    free_node(node);
+    throw;
+  }
+
+  stats.Count_++;
+  return S_OK;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::remove(const char* key) -> void {
+  if (try_remove(key) == S_ITEM_NOT_FOUND) {
+    throw OAHashTableException(
+      OAHashTableException::E_ITEM_NOT_FOUND,
+      "Key not in table."
+    );
+  }
+}
+
+template<typename T>
+auto CuckooHashTable<T>::try_remove(const char* key) -> OAHTStatus {
+  Node** slot = lookup(key, hash(key));
+
+  if (not slot) {
+    return S_ITEM_NOT_FOUND;
+  }
+
+  Node* node = std::exchange(*slot, nullptr);
+  stats.Count_--;
+
+  // the stash keeps its items together, the last one fills the hole
+  for (u32 i = 0; i < table.Stashed; i++) {
+    if (&table.Stash[i] == slot) {
+      table.Stashed--;
+      std::swap(table.Stash[i], table.Stash[table.Stashed]);
+      break;
+    }
+  }
+
+  if (config.FreeProc_) {
+    config.FreeProc_(std::move(node->Data));
+  }
+  free_node(node);
+
+  return S_OK;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::find(const char* key) const -> const T& {
+  const T* data = try_find(key);
+
+  if (not data) {
+    throw OAHashTableException(
+      OAHashTableException::E_ITEM_NOT_FOUND,
+      "Item not found in table."
+    );
+  }
+
+  return *data;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::try_find(const char* key) const -> const T* {
+  Node* const* slot = lookup(key, hash(key));
+
+  return slot ? &(*slot)->Data : nullptr;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::clear() -> void {
+  for (u32 i = 0; i < table.Stashed; i++) {
+    Node* node = std::exchange(table.Stash[i], nullptr);
+    stats.Count_--;
+
+    if (config.FreeProc_) {
+      config.FreeProc_(std::move(node->Data));
+    }
+    free_node(node);
+  }
+  table.Stashed = 0;
+
+  for (u32 i = 0; i < table.Count and size() > 0; i++) {
+    Bucket& bucket = table.Buckets[i];
+
+    for (u32 slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++) {
+      Node* node = std::exchange(bucket.Items[slot], nullptr);
+
+      if (not node) {
+        continue;
+      }
+
+      stats.Count_--;
+
+      if (config.FreeProc_) {
+        config.FreeProc_(std::move(node->Data));
+      }
+      free_node(node);
+    }
+  }
+}
+
+template<typename T>
+auto CuckooHashTable<T>::GetStats() const -> OAHTStats {
+  return stats;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::size() const -> u32 {
+  return stats.Count_;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::capacity() const -> u32 {
+  return table.Count * CUCKOO_BUCKET_SLOTS;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::hash(const char* key) const -> Hashes {
+  return hash(key, seed);
+}
+
+template<typename T>
+auto CuckooHashTable<T>::hash(const char* key, u64 seed) const -> Hashes {
+  if (seed != 0) {
+    // both from the key itself, the client hash functions put too many
+    // keys together
+    const u64 digest = FastHash64(key, std::strlen(key), seed);
+
+    return {static_cast<u32>(digest >> 32), static_cast<u32>(digest)};
+  }
+
+  // first() and second() only look at the high bits, which weak hash
+  // functions leave 0
+  const u32 primary =
+    OAHTMixHash(config.PrimaryHashFunc_(key, FULL_HASH_RANGE));
+
+  if (not config.SecondaryHashFunc_) {
+    // a hash of the key itself, so keys that collide on the primary hash
+    // still have second buckets of their own
+    return {primary, static_cast<u32>(
+      FastHash64(key, std::strlen(key), CUCKOO_SEED) >> 32
+    )};
+  }
+
+  return {
+    primary,
+    OAHTMixHash(config.SecondaryHashFunc_(key, FULL_HASH_RANGE))
+  };
+}
+
+template<typename T>
+auto CuckooHashTable<T>::next_seed(u64 seed) -> u64 {
+  // CUCKOO_SEED is odd, so its multiples only come back to 0 after 2^64
+  return seed + CUCKOO_SEED;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::first(const Array& array, u32 primary) -> u32 {
+  // (hash * count) / 2^32, any count works
+  return static_cast<u32>((u64{primary} * array.Count) >> 32);
+}
+
+template<typename T>
+auto CuckooHashTable<T>::second(
+  const Array& array,
+  u32 primary,
+  u32 secondary
+) -> u32 {
+  const u32 home = first(array, primary);
+  const u32 bucket = static_cast<u32>((u64{secondary} * array.Count) >> 32);
+
+  if (bucket != home or array.Count == 1) {
+    return bucket;
+  }
+
+  return bucket + 1 == array.Count ? 0 : bucket + 1;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::other(
+  const Array& array,
+  const Node& node,
+  u32 bucket
+) -> u32 {
+  const u32 home = first(array, node.Primary);
+
+  return bucket == home ? second(array, node.Primary, node.Secondary) : home;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::lookup(const char* key, const Hashes& hashes) const
+  -> Node** {
+  const u32 buckets[]{
+    first(table, hashes.Primary),
+    second(table, hashes.Primary, hashes.Secondary)
+  };
+
+  // both loads are under way before the first compare
+  __builtin_prefetch(&table.Buckets[buckets[1]]);
+
+  for (const u32 index : buckets) {
+    Bucket& bucket = table.Buckets[index];
+
+    stats.Probes_++;
+    for (u32 slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++) {
+      if (bucket.Tags[slot] == hashes.Primary and bucket.Items[slot]
+          and std::strcmp(bucket.Items[slot]->key(), key) == 0) {
+        return &bucket.Items[slot];
+      }
+    }
+  }
+
+  for (u32 i = 0; i < table.Stashed; i++) {
+    Node* const& node = table.Stash[i];
+
+    stats.Probes_++;
+    if (node->Primary == hashes.Primary
+        and std::strcmp(node->key(), key) == 0) {
+      // only try_find calls this on a const table, and it does not write
+      return const_cast<Node**>(&node);
+    }
+  }
+
+  return nullptr;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::visited(
+  const std::vector<Step>& steps,
+  usize step,
+  u32 bucket
+) -> bool {
+  for (;; step = steps[step].Parent) {
+    if (steps[step].Index == bucket) {
+      return true;
+    }
+
+    if (steps[step].Depth == 0) {
+      return false;
+    }
+  }
+}
+
+template<typename T>
+auto CuckooHashTable<T>::make_array(u32 count) const -> Array {
+  // the pair of the config only if it is complete, one of them cannot free
+  // what the other allocates
+  const bool client = config.AllocFunc_ and config.DeallocFunc_;
+
+  try {
+    return Array{
+      OAHTAllocate<Bucket>(
+        count,
+        client ? config.AllocFunc_ : HugePageAlloc,
+        client ? config.DeallocFunc_ : HugePageFree
+      ),
+      count
+    };
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
+  }
+}
+
+template<typename T>
+template<typename... Args>
+auto CuckooHashTable<T>::make_node(
+  const char* key,
+  const Hashes& hashes,
+  Args&&... args
+) -> Node* {
+  const usize length = std::strlen(key);
+  void* memory = nullptr;
+
+  try {
+    memory = ::operator new(sizeof(Node) + length + 1);
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
+  }
+
+  Node* node = nullptr;
+
+  try {
+    node = new (memory)
+      Node(hashes.Primary, hashes.Secondary, std::forward<Args>(args)...);
+  } catch (...) {
+    ::operator delete(memory);
+    throw;
+  }
+
+  std::memcpy(reinterpret_cast<char*>(node + 1), key, length + 1);
+  return node;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::free_node(Node* node) -> void {
+  node->~Node();
+  ::operator delete(node);
+}
+
+template<typename T>
+auto CuckooHashTable<T>::place(Array& array, Node* node) const -> bool {
+  const u32 home = first(array, node->Primary);
+  const u32 away = second(array, node->Primary, node->Secondary);
+
+  // most inserts find a free slot in one of the two buckets
+  for (const u32 index : {home, away}) {
+    Bucket& bucket = array.Buckets[index];
+
+    for (u32 slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++) {
+      if (not bucket.Items[slot]) {
+        bucket.Tags[slot] = node->Primary;
+        bucket.Items[slot] = node;
+        return true;
+      }
+    }
+  }
+
+  // breadth first, so the chain of items that move is as short as can be
+  std::vector<Step> steps{{home, 0, 0, 0}};
+  if (away != home) {
+    steps.push_back({away, 0, 0, 0});
+  }
+
+  for (usize i = 0; i < steps.size(); i++) {
+    const Step step = steps[i];
+    const Bucket& bucket = array.Buckets[step.Index];
+
+    for (u32 slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++) {
+      if (bucket.Items[slot]) {
+        continue;
+      }
+
+      // every item along the chain moves one step down it, starting with
+      // the one that goes into the free slot
+      usize to = i;
+      u32 free = slot;
+
+      for (; steps[to].Depth > 0; to = steps[to].Parent) {
+        Bucket& target = array.Buckets[steps[to].Index];
+        Bucket& source = array.Buckets[steps[steps[to].Parent].Index];
+        const u32 from = steps[to].Slot;
+
+        target.Tags[free] = source.Tags[from];
+        target.Items[free] = source.Items[from];
+        free = from;
+      }
+
+      Bucket& target = array.Buckets[steps[to].Index];
+      target.Tags[free] = node->Primary;
+      target.Items[free] = node;
+      return true;
+    }
+
+    if (step.Depth == CUCKOO_MAX_PATH) {
+      continue;
+    }
+
+    for (u32 slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++) {
+      const u32 next = other(array, *bucket.Items[slot], step.Index);
+
+      // a chain through a bucket twice would move items out of it that
+      // are not where the search saw them
+      if (steps.size() < CUCKOO_MAX_SEARCH and not visited(steps, i, next)) {
+        steps.push_back({next, static_cast<u32>(i), slot, step.Depth + 1});
+      }
+    }
+  }
+
+  return false;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::stash(Array& array, Node* node) -> bool {
+  if (array.Stashed == CUCKOO_STASH_SLOTS) {
+    return false;
+  }
+
+  array.Stash[array.Stashed++] = node;
+  return true;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::grow(bool full) -> bool {
+  const f64 load_factor{
+    static_cast<f64>(size() + 1) / static_cast<f64>(capacity())
+  };
+
+  const bool over =
+    size() + 1 > capacity() or load_factor > config.MaxLoadFactor_;
+
+  if (not full and not over) {
+    return true;
+  }
+
+  // too many keys share both of their buckets for more buckets to help.
+  // The insert already grew for MaxLoadFactor_, so this holds even for a
+  // factor that no table meets
+  if (full and load_factor < 0.25) {
+    return false;
+  }
+
+  stats.Expansions_++;
+
+  u32 grown = std::max(
+    static_cast<u32>(std::ceil(config.GrowthFactor_ * table.Count)),
+    table.Count + 1
+  );
+
+  // straight to the buckets that fit one more item, there are none for a
+  // MaxLoadFactor_ of 0 or less, and then growing once has to do
+  if (config.MaxLoadFactor_ > 0) {
+    const f64 needed{
+      std::ceil((size() + 1) / (config.MaxLoadFactor_ * CUCKOO_BUCKET_SLOTS))
+    };
+    const f64 largest{std::numeric_limits<u32>::max() / CUCKOO_BUCKET_SLOTS};
+    grown = std::max(grown, static_cast<u32>(std::min(needed, largest)));
+  }
+
+  resize(grown, seed);
+  return true;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::resize(u32 count, u64 seed) -> void {
+  for (u32 tries = 1; not rebuild(count, seed); tries++) {
+    // more items share both of their buckets than the stash holds: hash the
+    // keys apart, and make room as well if new seeds keep failing
+    seed = next_seed(seed);
+
+    if (tries % CUCKOO_MAX_RESEEDS == 0) {
+      stats.Expansions_++;
+      count *= 2;
+    }
+  }
+}
+
+template<typename T>
+auto CuckooHashTable<T>::rebuild(u32 count, u64 seed) -> bool {
+  Array array{make_array(count)};
+  const bool reseeded = seed != this->seed;
+
+  if (reseeded) {
+    rehash(seed);
+  }
+
+  bool fits = true;
+
+  for (u32 i = 0; i < table.Count and fits; i++) {
+    const Bucket& bucket = table.Buckets[i];
+
+    for (u32 slot = 0; slot < CUCKOO_BUCKET_SLOTS and fits; slot++) {
+      Node* node = bucket.Items[slot];
+
+      fits = not node or place(array, node) or stash(array, node);
+    }
+  }
+
+  for (u32 i = 0; i < table.Stashed and fits; i++) {
+    fits = place(array, table.Stash[i]) or stash(array, table.Stash[i]);
+  }
+
+  if (not fits) {
+    // the items are still where the old hashes put them
+    if (reseeded) {
+      rehash(this->seed);
+    }
+    return false;
+  }
+
+  table = std::move(array);
+  this->seed = seed;
+  stats.TableSize_ = capacity();
+  return true;
+}
+
+template<typename T>
+auto CuckooHashTable<T>::rehash(u64 seed) -> void {
+  auto update = [this, seed](Node* node) {
+    const Hashes hashes = hash(node->key(), seed);
+    node->Primary = hashes.Primary;
+    node->Secondary = hashes.Secondary;
+  };
+
+  for (u32 i = 0; i < table.Count; i++) {
+    const Bucket& bucket = table.Buckets[i];
+
+    for (u32 slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++) {
+      if (bucket.Items[slot]) {
+        update(bucket.Items[slot]);
+      }
+    }
+  }
+
+  for (u32 i = 0; i < table.Stashed; i++) {
+    update(table.Stash[i]);
+  }
+}
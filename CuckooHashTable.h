@@ -0,0 +1,236 @@
+//---------------------------------------------------------------------------
+#ifndef CUCKOOHASHTABLEH
+#define CUCKOOHASHTABLEH
+//---------------------------------------------------------------------------
+
+#include "OAHashTable.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Slots in a bucket of a CuckooHashTable, all of them share one cache
+ * line with their hashes
+ */
+const u32 CUCKOO_BUCKET_SLOTS = 4;
+
+/**
+ * @brief Most buckets an insert into a CuckooHashTable searches for a chain
+ * of items to move aside before it grows the table instead
+ */
+const u32 CUCKOO_MAX_SEARCH = 256;
+
+/**
+ * @brief Longest chain of items an insert into a CuckooHashTable moves aside
+ */
+const u32 CUCKOO_MAX_PATH = 5;
+
+/**
+ * @brief Most items the stash of a CuckooHashTable holds, a lookup compares
+ * against at most this many after its two buckets
+ */
+const u32 CUCKOO_STASH_SLOTS = 4;
+
+/**
+ * @brief How many new seeds a CuckooHashTable tries in a row for a rebuild
+ * that leaves more items out of their buckets than the stash holds, before
+ * it doubles the number of buckets as well
+ */
+const u32 CUCKOO_MAX_RESEEDS = 8;
+
+/**
+ * @brief Seed of the hash that picks the second bucket of a key in a
+ * CuckooHashTable without a SecondaryHashFunc_, so that keys the primary
+ * hash function puts together still have second buckets of their own. Its
+ * multiples are the seeds the table tries once it hashes keys by itself
+ */
+const std::uint64_t CUCKOO_SEED = 0xA0761D6478BD642Full;
+
+//! Bucketized cuckoo hash table: every key has two candidate buckets of
+//! CUCKOO_BUCKET_SLOTS slots each, one picked by the primary and one by the
+//! secondary hash function, or else in the stash. A lookup reads at most
+//! those two buckets (a cache line each) and the CUCKOO_STASH_SLOTS items
+//! of the stash, then compares the key of an item whose hash matches,
+//! however full the table and however bad the keys.
+//!
+//! An insert that finds both buckets full moves items that are in the way to
+//! their other bucket, along the shortest such chain (breadth first, up to
+//! CUCKOO_MAX_PATH moves). If there is none it grows the table, unless the
+//! table is less than a quarter full: then too many keys share both of their
+//! buckets for growing to help, and the item goes into the stash instead.
+//! The stash stays empty unless the hash functions send more keys to the
+//! same two buckets than they hold. Once it is full, the table stops using
+//! the client hash functions and hashes the keys itself, with FastHash64 and
+//! a new seed for every rebuild that would still overflow the stash.
+//!
+//! Items live in nodes holding the key and data, so they never move in
+//! memory once inserted. Only InitialTableSize_, PrimaryHashFunc_,
+//! SecondaryHashFunc_, MaxLoadFactor_, GrowthFactor_, FreeProc_, AllocFunc_
+//! and DeallocFunc_ of the config are used. Without a SecondaryHashFunc_
+//! the second bucket comes from FastHash64 of the key seeded with
+//! CUCKOO_SEED. The buckets come from AllocFunc_ and DeallocFunc_ if both
+//! are set, or else from HugePageAlloc (HugePages.h), which starts every
+//! bucket on a cache line
+template<typename T>
+class CuckooHashTable {
+public:
+
+  using OAHTConfig = typename OAHashTable<T>::OAHTConfig;
+
+  explicit CuckooHashTable(const OAHTConfig& config);
+
+  ~CuckooHashTable();
+
+  CuckooHashTable(const CuckooHashTable&) = delete;
+  auto operator=(const CuckooHashTable&) -> CuckooHashTable& = delete;
+
+  // They work like their OAHashTable counterparts
+  auto insert(const char* key, const T& data) -> void;
+
+  auto insert(const char* key, T&& data) -> void;
+
+  template<typename... Args>
+  auto emplace(const char* key, Args&&... args) -> void;
+
+  auto try_insert(const char* key, const T& data) -> OAHTStatus;
+
+  auto try_insert(const char* key, T&& data) -> OAHTStatus;
+
+  template<typename... Args>
+  auto try_emplace(const char* key, Args&&... args) -> OAHTStatus;
+
+  auto remove(const char* key) -> void;
+
+  auto try_remove(const char* key) -> OAHTStatus;
+
+  // The data stays where it is until its item is removed
+  auto find(const char* key) const -> const T&;
+
+  auto try_find(const char* key) const -> const T*;
+
+  auto clear() -> void;
+
+  // Probes_ counts buckets, at most two per lookup, and each stashed item
+  // a lookup compares against. There are no tombstones
+  auto GetStats() const -> OAHTStats;
+
+  auto size() const -> u32;
+
+  // In slots, CUCKOO_BUCKET_SLOTS per bucket
+  auto capacity() const -> u32;
+
+private:
+
+  struct Node {
+    template<typename... Args>
+    Node(u32 primary, u32 secondary, Args&&... args):
+        Data(std::forward<Args>(args)...),
+        Primary{primary},
+        Secondary{secondary} {}
+
+    // the key is allocated right behind the node
+    auto key() const -> const char* {
+      return reinterpret_cast<const char*>(this + 1);
+    }
+
+    T Data;
+    u32 Primary;   // hash that picks the first bucket
+    u32 Secondary; // hash that picks the second bucket
+  };
+
+  struct Bucket {
+    u32 Tags[CUCKOO_BUCKET_SLOTS]{};    // Primary of each item
+    Node* Items[CUCKOO_BUCKET_SLOTS]{}; // nullptr for a free slot
+    char Padding[64 - CUCKOO_BUCKET_SLOTS * (sizeof(u32) + sizeof(Node*))];
+  };
+
+  struct Array {
+    OAHTArray<Bucket> Buckets{};
+    u32 Count{0};
+    Node* Stash[CUCKOO_STASH_SLOTS]{}; // items that fit in neither bucket
+    u32 Stashed{0};                    // the first Stashed are in use
+  };
+
+  // A bucket reached while looking for room, and how: the item in slot
+  // Slot of the bucket of step Parent moves to bucket Index
+  struct Step {
+    u32 Index;
+    u32 Parent;
+    u32 Slot;
+    u32 Depth;
+  };
+
+  struct Hashes {
+    u32 Primary;
+    u32 Secondary;
+  };
+
+  auto hash(const char* key) const -> Hashes;
+
+  // The hashes of key under a seed, see seed below
+  auto hash(const char* key, u64 seed) const -> Hashes;
+
+  // The seed tried after seed
+  static auto next_seed(u64 seed) -> u64;
+
+  // The two buckets of an item with these hashes, always different unless
+  // there is only one
+  static auto first(const Array& array, u32 primary) -> u32;
+
+  static auto second(const Array& array, u32 primary, u32 secondary) -> u32;
+
+  // The bucket of node other than bucket
+  static auto other(const Array& array, const Node& node, u32 bucket) -> u32;
+
+  // The slot (in a bucket or the stash) holding the item of key, or nullptr
+  auto lookup(const char* key, const Hashes& hashes) const -> Node**;
+
+  // Whether the path to step already went through bucket
+  static auto visited(const std::vector<Step>& steps, usize step, u32 bucket)
+    -> bool;
+
+  auto make_array(u32 count) const -> Array;
+
+  template<typename... Args>
+  auto make_node(const char* key, const Hashes& hashes, Args&&... args)
+    -> Node*;
+
+  static auto free_node(Node* node) -> void;
+
+  // Puts node in one of its buckets, moving other items aside if need be.
+  // Returns false, with nothing moved, if there is no room
+  auto place(Array& array, Node* node) const -> bool;
+
+  // Adds node to the stash of array, returns false if it is full
+  static auto stash(Array& array, Node* node) -> bool;
+
+  // Grows the table before an insert would go past MaxLoadFactor_, or when
+  // full is set because an insert found no room. Returns false, with nothing
+  // done, if the table is too empty for growing to make room
+  auto grow(bool full) -> bool;
+
+  // Moves every item into a new array of count buckets hashed with seed,
+  // trying new seeds (and after CUCKOO_MAX_RESEEDS of them, twice the
+  // buckets) until every item fits in its buckets or the stash
+  auto resize(u32 count, u64 seed) -> void;
+
+  // Moves every item into a new array of count buckets, hashed with seed,
+  // those that fit in neither of their buckets into its stash. Returns
+  // false, with the table left as it was, if the stash overflows
+  auto rebuild(u32 count, u64 seed) -> bool;
+
+  // Gives every item of the table the hashes of its key under seed
+  auto rehash(u64 seed) -> void;
+
+  OAHTConfig config;
+  mutable OAHTStats stats{};
+
+  Array table{};
+
+  // 0 while the client hash functions pick the buckets, otherwise both
+  // come from FastHash64 of the key with this seed
+  u64 seed{0};
+};
+
+#include "CuckooHashTable.cpp"
+
+#endif
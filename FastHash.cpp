@@ -0,0 +1,135 @@
+/*********************************************************/
+/* 64 bit string hash after wyhash (Wang Yi, public      */
+/* domain): every step multiplies two 64 bit words to a  */
+/* 128 bit product and folds its halves together         */
+/*********************************************************/
+
+#include "FastHash.h"
+#include <cstring>
+
+namespace {
+
+using u64 = std::uint64_t;
+
+const u64 P0 = 0xa0761d6478bd642full;
+const u64 P1 = 0xe7037ed1a0b428dbull;
+const u64 P2 = 0x8ebc6af09c88c6e3ull;
+const u64 P3 = 0x589965cc75374cc3ull;
+
+// a:b = a * b (low:high)
+inline void Multiply(u64& a, u64& b) {
+#if defined(__SIZEOF_INT128__)
+  __extension__ typedef unsigned __int128 u128;
+
+  const u128 product = static_cast<u128>(a) * b;
+  a = static_cast<u64>(product);
+  b = static_cast<u64>(product >> 64);
+#else
+  const u64 a_high = a >> 32, a_low = a & 0xFFFFFFFF;
+  const u64 b_high = b >> 32, b_low = b & 0xFFFFFFFF;
+  const u64 high = a_high * b_high, low = a_low * b_low;
+  const u64 middle = a_high * b_low + (low >> 32);
+  const u64 middle2 = a_low * b_high + (middle & 0xFFFFFFFF);
+
+  a = (middle2 << 32) | (low & 0xFFFFFFFF);
+  b = high + (middle >> 32) + (middle2 >> 32);
+#endif
+}
+
+inline u64 Mix(u64 a, u64 b) {
+  Multiply(a, b);
+  return a ^ b;
+}
+
+inline u64 Read8(const char* p) {
+  u64 value;
+  std::memcpy(&value, p, sizeof value);
+  return value;
+}
+
+inline u64 Read4(const char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof value);
+  return value;
+}
+
+// 1 to 3 bytes, the middle one is read twice for length 1 and 2
+inline u64 Read3(const char* p, std::size_t length) {
+  return static_cast<u64>(static_cast<unsigned char>(p[0])) << 16
+         | static_cast<u64>(static_cast<unsigned char>(p[length >> 1])) << 8
+         | static_cast<u64>(static_cast<unsigned char>(p[length - 1]));
+}
+
+} // namespace
+
+u64 FastHash64(const char* key, std::size_t length, u64 seed) {
+  const char* p = key;
+  u64 a, b;
+
+  seed ^= Mix(seed ^ P0, P1);
+
+  if (length <= 16) {
+    // two (possibly overlapping) 4 byte reads from each end
+    if (length >= 4) {
+      const std::size_t half = (length >> 3) << 2;
+
+      a = (Read4(p) << 32) | Read4(p + half);
+      b = (Read4(p + length - 4) << 32) | Read4(p + length - 4 - half);
+    } else if (length > 0) {
+      a = Read3(p, length);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    std::size_t rest = length;
+
+    // three independent lanes so the multiplies can overlap
+    if (rest > 48) {
+      u64 seed1 = seed, seed2 = seed;
+
+      do {
+        seed = Mix(Read8(p) ^ P1, Read8(p + 8) ^ seed);
+        seed1 = Mix(Read8(p + 16) ^ P2, Read8(p + 24) ^ seed1);
+        seed2 = Mix(Read8(p + 32) ^ P3, Read8(p + 40) ^ seed2);
+        p += 48;
+        rest -= 48;
+      } while (rest > 48);
+
+      seed ^= seed1 ^ seed2;
+    }
+
+    while (rest > 16) {
+      seed = Mix(Read8(p) ^ P1, Read8(p + 8) ^ seed);
+      p += 16;
+      rest -= 16;
+    }
+
+    // the last 16 bytes, overlapping what was already mixed
+    a = Read8(p + rest - 16);
+    b = Read8(p + rest - 8);
+  }
+
+  a ^= P1;
+  b ^= seed;
+  Multiply(a, b);
+
+  return Mix(a ^ P0 ^ length, b ^ P1);
+}
+
+unsigned FastHash(const char* Key, unsigned TableSize) {
+  const u64 hash = FastHash64(Key, std::strlen(Key));
+
+  // (high half * TableSize) / 2^32 is in range without a division
+  return static_cast<unsigned>(((hash >> 32) * TableSize) >> 32);
+}
+
+unsigned FastHash2(const char* Key, unsigned TableSize) {
+  const u64 hash = FastHash64(Key, std::strlen(Key));
+
+  return static_cast<unsigned>(((hash & 0xFFFFFFFF) * TableSize) >> 32);
+}
+
+u64 FastDigest(const char* Key) {
+  return FastHash64(Key, std::strlen(Key));
+}
@@ -0,0 +1,35 @@
+//---------------------------------------------------------------------------
+#ifndef FASTHASHH
+#define FASTHASHH
+//---------------------------------------------------------------------------
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 64 bit hash of length bytes at key (wyhash construction)
+ *
+ * Reads 8 bytes per load and folds 16 bytes per multiply, keys of up to 16
+ * bytes take a single multiply and keys of up to 32 bytes two.
+ */
+std::uint64_t FastHash64(const char* key, std::size_t length,
+                         std::uint64_t seed = 0);
+
+/**
+ * @brief HASHFUNC for null terminated keys, the high half of FastHash64
+ * scaled to [0, TableSize)
+ */
+unsigned FastHash(const char* Key, unsigned TableSize);
+
+/**
+ * @brief Secondary HASHFUNC for double hashing, the low half of the same
+ * FastHash64 scaled to [0, TableSize)
+ */
+unsigned FastHash2(const char* Key, unsigned TableSize);
+
+/**
+ * @brief DIGESTFUNC for null terminated keys, the whole FastHash64
+ */
+std::uint64_t FastDigest(const char* Key);
+
+#endif
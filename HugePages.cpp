@@ -0,0 +1,78 @@
+/*********************************************************/
+/* Memory on 2 MB pages: the mapping is made one page    */
+/* larger than needed, then trimmed to a page boundary   */
+/* and handed to the kernel's transparent huge pages     */
+/*********************************************************/
+
+#include "HugePages.h"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+namespace {
+
+const std::size_t CACHE_LINE = 64;
+
+inline std::size_t RoundUp(std::size_t bytes) {
+  return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+} // namespace
+
+void* HugePageAlloc(std::size_t bytes) {
+  if (bytes < HUGE_PAGE_SIZE) {
+    void* memory = nullptr;
+
+    if (posix_memalign(&memory, CACHE_LINE, bytes > 0 ? bytes : 1) != 0) {
+      throw std::bad_alloc{};
+    }
+    return memory;
+  }
+
+  const std::size_t length = RoundUp(bytes);
+  void* mapping = mmap(
+    nullptr,
+    length + HUGE_PAGE_SIZE,
+    PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS,
+    -1,
+    0
+  );
+
+  if (mapping == MAP_FAILED) {
+    throw std::bad_alloc{};
+  }
+
+  char* const start = static_cast<char*>(mapping);
+  const std::size_t head = (HUGE_PAGE_SIZE
+                            - reinterpret_cast<std::uintptr_t>(start)
+                                % HUGE_PAGE_SIZE)
+                           % HUGE_PAGE_SIZE;
+
+  // give back what lies outside the aligned pages
+  if (head > 0) {
+    munmap(start, head);
+  }
+  munmap(start + head + length, HUGE_PAGE_SIZE - head);
+
+#ifdef MADV_HUGEPAGE
+  // only a hint, the memory works the same on small pages
+  madvise(start + head, length, MADV_HUGEPAGE);
+#endif
+
+  return start + head;
+}
+
+void HugePageFree(void* memory, std::size_t bytes) {
+  if (memory == nullptr) {
+    return;
+  }
+
+  if (bytes < HUGE_PAGE_SIZE) {
+    std::free(memory);
+    return;
+  }
+
+  munmap(memory, RoundUp(bytes));
+}
@@ -0,0 +1,30 @@
+//---------------------------------------------------------------------------
+#ifndef HUGEPAGESH
+#define HUGEPAGESH
+//---------------------------------------------------------------------------
+
+#include <cstddef>
+
+/**
+ * @brief Size of a transparent huge page on x86-64 (and most arm64 setups)
+ */
+const std::size_t HUGE_PAGE_SIZE = std::size_t{2} << 20;
+
+/**
+ * @brief ALLOCFUNC that puts big arrays on 2 MB transparent huge pages
+ *
+ * Requests of at least HUGE_PAGE_SIZE bytes are mapped on their own, rounded
+ * up to and aligned on whole huge pages, and marked for huge pages, so that
+ * one TLB entry covers 2 MB instead of 4 KB. Whether the kernel backs them
+ * with huge pages depends on /sys/kernel/mm/transparent_hugepage/enabled
+ * (always or madvise). Smaller requests come from the heap, aligned on a
+ * cache line. Throws std::bad_alloc when out of memory.
+ */
+void* HugePageAlloc(std::size_t bytes);
+
+/**
+ * @brief DEALLOCFUNC for memory from HugePageAlloc, bytes as allocated
+ */
+void HugePageFree(void* memory, std::size_t bytes);
+
+#endif
@@ -0,0 +1,497 @@
+#pragma once
+
+#include "LockFreeOAHashTable.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <thread>
+#include <utility>
+
+template<typename T>
+LockFreeOAHashTable<T>::LockFreeOAHashTable(const OAHTConfig& config):
+    config{config},
+    first{new Array{std::max(config.InitialTableSize_, u32{1})}} {
+  current.store(first, std::memory_order_release);
+}
+
+template<typename T>
+LockFreeOAHashTable<T>::~LockFreeOAHashTable() {
+  // every item ends up in the last array, the others only point to it
+  Array* last = current.load(std::memory_order_acquire);
+
+  while (Array* next = last->Next.load(std::memory_order_acquire)) {
+    last = next;
+  }
+
+  for (u32 i = 0; i < last->Capacity; i++) {
+    const Slot& slot = last->Slots[i];
+
+    if (state_of(slot.Control.load(std::memory_order_acquire)) != FULL) {
+      continue;
+    }
+
+    Node* node = slot.Item.load(std::memory_order_relaxed);
+
+    if (config.FreeProc_) {
+      config.FreeProc_(std::move(node->Data));
+    }
+    free_node(node);
+  }
+
+  while (first) {
+    delete std::exchange(first, first->Next.load(std::memory_order_acquire));
+  }
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::insert(const char* key, const T& data) -> void {
+  emplace(key, data);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::insert(const char* key, T&& data) -> void {
+  emplace(key, std::move(data));
+}
+
+template<typename T>
+template<typename... Args>
+auto LockFreeOAHashTable<T>::emplace(const char* key, Args&&... args)
+  -> void {
+  if (try_emplace(key, std::forward<Args>(args)...) == S_DUPLICATE) {
+    throw OAHashTableException(
+      OAHashTableException::E_DUPLICATE,
+      "Duplicate key"
+    );
+  }
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::try_insert(const char* key, const T& data)
+  -> OAHTStatus {
+  return try_emplace(key, data);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::try_insert(const char* key, T&& data)
+  -> OAHTStatus {
+  return try_emplace(key, std::move(data));
+}
+
+template<typename T>
+template<typename... Args>
+auto LockFreeOAHashTable<T>::try_emplace(const char* key, Args&&... args)
+  -> OAHTStatus {
+  const u32 hash = this->hash(key);
+  Node* node = nullptr;
+  OAHTStatus status = S_OK;
+  Array* array = nullptr;
+
+  // inserts wait for a resize to finish, so no item is ever put into an
+  // array that has already been partly moved
+  for (;;) {
+    array = current.load(std::memory_order_acquire);
+
+    if (array->Next.load(std::memory_order_acquire)) {
+      help_migrate(*array);
+      continue;
+    }
+
+    if (place(*array, key, hash, node, status, std::forward<Args>(args)...)) {
+      break;
+    }
+  }
+
+  if (status == S_DUPLICATE) {
+    // another thread put the key in after the data was moved into node
+    if (node) {
+      if (config.FreeProc_) {
+        config.FreeProc_(std::move(node->Data));
+      }
+      free_node(node);
+    }
+    return status;
+  }
+
+  const u64 counted{
+    counts[stripe()].Value.fetch_add(1, std::memory_order_relaxed) + 1
+  };
+
+  // adding up the stripes reads every one of them, so big tables only do it
+  // every so often and may go a little past MaxLoadFactor_
+  const bool check = array->Capacity < 4 * MIGRATION_CHUNK
+                  or counted % COUNT_STRIPES == 0;
+
+  if (check and overloaded(*array)) {
+    grow(*array);
+  }
+
+  return S_OK;
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::find(const char* key) const -> const T& {
+  const T* data = try_find(key);
+
+  if (data) {
+    return *data;
+  }
+
+  throw OAHashTableException(
+    OAHashTableException::E_ITEM_NOT_FOUND,
+    "Item not found in table."
+  );
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::try_find(const char* key) const -> const T* {
+  const u32 hash = this->hash(key);
+
+  for (const Array* array = current.load(std::memory_order_acquire); array;
+       array = array->Next.load(std::memory_order_acquire)) {
+    u32 index = home(*array, hash);
+
+    for (u32 i = 0; i < array->Capacity; i++) {
+      const Slot& slot = array->Slots[index];
+      const u64 word = slot.Control.load(std::memory_order_acquire);
+      const SlotState state = state_of(word);
+
+      if (state == EMPTY) {
+        break;
+      }
+
+      // a moved item is still a valid node, there is no need to go after it
+      const Node* item{
+        state == BUSY ? nullptr : slot.Item.load(std::memory_order_relaxed)
+      };
+
+      if (state == MOVED and not item) {
+        break;
+      }
+
+      if (item and hash_of(word) == hash
+          and std::strcmp(item->key(), key) == 0) {
+        return &item->Data;
+      }
+
+      index = index + 1 == array->Capacity ? 0 : index + 1;
+    }
+
+    // the end of the probe sequence, but once a resize has started the key
+    // may have been inserted into the next array
+  }
+
+  return nullptr;
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::GetStats() const -> OAHTStats {
+  OAHTStats stats{};
+
+  stats.Count_ = size();
+  stats.TableSize_ = capacity();
+  stats.Expansions_ = expansions.load(std::memory_order_relaxed);
+  stats.PrimaryHashFunc_ = config.PrimaryHashFunc_;
+
+  return stats;
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::size() const -> u32 {
+  u64 count = 0;
+
+  for (usize i = 0; i < COUNT_STRIPES; i++) {
+    count += counts[i].Value.load(std::memory_order_relaxed);
+  }
+
+  return static_cast<u32>(count);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::capacity() const -> u32 {
+  return current.load(std::memory_order_acquire)->Capacity;
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::control(u32 hash, SlotState state) -> u64 {
+  return u64{hash} << 32 | state;
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::state_of(u64 control) -> SlotState {
+  return static_cast<SlotState>(control & 3);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::hash_of(u64 control) -> u32 {
+  return static_cast<u32>(control >> 32);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::settled(const Slot& slot) -> u64 {
+  u64 word = slot.Control.load(std::memory_order_acquire);
+
+  // the claiming thread only has two stores left to do
+  while (state_of(word) == BUSY) {
+    std::this_thread::yield();
+    word = slot.Control.load(std::memory_order_acquire);
+  }
+
+  return word;
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::hash(const char* key) const -> u32 {
+  // home() only looks at the high bits, which weak hash functions leave 0
+  return OAHTMixHash(config.PrimaryHashFunc_(key, FULL_HASH_RANGE));
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::home(const Array& array, u32 hash) -> u32 {
+  // (hash * capacity) / 2^32, any capacity works
+  return static_cast<u32>((u64{hash} * array.Capacity) >> 32);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::stripe() -> usize {
+  static std::atomic<usize> threads{0};
+  static thread_local const usize stripe{
+    threads.fetch_add(1, std::memory_order_relaxed) % COUNT_STRIPES
+  };
+
+  return stripe;
+}
+
+template<typename T>
+template<typename... Args>
+auto LockFreeOAHashTable<T>::make_node(
+  const char* key,
+  u32 hash,
+  Args&&... args
+) -> Node* {
+  const usize length = std::strlen(key);
+  void* memory = nullptr;
+
+  try {
+    memory = ::operator new(sizeof(Node) + length + 1);
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
+  }
+
+  Node* node = nullptr;
+
+  try {
+    node = new (memory) Node(hash, std::forward<Args>(args)...);
+  } catch (...) {
+    ::operator delete(memory);
+    throw;
+  }
+
+  std::memcpy(reinterpret_cast<char*>(node + 1), key, length + 1);
+  return node;
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::free_node(Node* node) -> void {
+  node->~Node();
+  ::operator delete(node);
+}
+
+template<typename T>
+template<typename... Args>
+auto LockFreeOAHashTable<T>::place(
+  Array& array,
+  const char* key,
+  u32 hash,
+  Node*& node,
+  OAHTStatus& status,
+  Args&&... args
+) -> bool {
+  u32 index = home(array, hash);
+
+  for (u32 i = 0; i < array.Capacity; i++) {
+    Slot& slot = array.Slots[index];
+    u64 word = slot.Control.load(std::memory_order_acquire);
+
+    if (state_of(word) == EMPTY) {
+      // built before claiming, so that other threads wait on BUSY as
+      // briefly as possible (made at most once, args are not reused)
+      if (not node) {
+        node = make_node(key, hash, std::forward<Args>(args)...);
+      }
+
+      if (slot.Control.compare_exchange_strong(
+            word,
+            control(hash, BUSY),
+            std::memory_order_acq_rel,
+            std::memory_order_acquire
+          )) {
+        slot.Item.store(node, std::memory_order_relaxed);
+        slot.Control.store(control(hash, FULL), std::memory_order_release);
+        node = nullptr;
+        status = S_OK;
+        return true;
+      }
+      // lost the race for the slot, word is what the winner put there
+    }
+
+    if (state_of(word) == MOVED) {
+      return false;
+    }
+
+    if (hash_of(word) == hash) {
+      word = settled(slot);
+
+      if (state_of(word) == MOVED) {
+        return false;
+      }
+
+      const Node* item = slot.Item.load(std::memory_order_relaxed);
+
+      if (std::strcmp(item->key(), key) == 0) {
+        status = S_DUPLICATE;
+        return true;
+      }
+    }
+
+    index = index + 1 == array.Capacity ? 0 : index + 1;
+  }
+
+  grow(array);
+  return false;
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::grow(Array& array) -> void {
+  if (not array.Next.load(std::memory_order_acquire)
+      and not array.Growing.exchange(true, std::memory_order_acq_rel)) {
+    u32 capacity = std::max(
+      static_cast<u32>(std::ceil(config.GrowthFactor_ * array.Capacity)),
+      array.Capacity + 1
+    );
+
+    // straight to the capacity that fits one more item, there is none for
+    // a MaxLoadFactor_ of 0 or less, and then growing once has to do
+    if (config.MaxLoadFactor_ > 0) {
+      const f64 needed{std::ceil((size() + 1) / config.MaxLoadFactor_)};
+      const f64 largest{std::numeric_limits<u32>::max()};
+      capacity = std::max(
+        capacity,
+        static_cast<u32>(std::min(needed, largest))
+      );
+    }
+
+    Array* next = nullptr;
+
+    try {
+      next = new Array{capacity};
+    } catch (const std::bad_alloc&) {
+      array.Growing.store(false, std::memory_order_release);
+      throw OAHashTableException(
+        OAHashTableException::E_NO_MEMORY,
+        "std::bad_alloc thrown: no memory"
+      );
+    }
+
+    expansions.fetch_add(1, std::memory_order_relaxed);
+    array.Next.store(next, std::memory_order_release);
+  }
+
+  help_migrate(array);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::help_migrate(Array& array) -> void {
+  Array* next = array.Next.load(std::memory_order_acquire);
+
+  while (not next) {
+    // the thread allocating it failed, whoever inserts next tries again
+    if (not array.Growing.load(std::memory_order_acquire)) {
+      return;
+    }
+
+    std::this_thread::yield();
+    next = array.Next.load(std::memory_order_acquire);
+  }
+
+  for (;;) {
+    const u64 start{
+      array.Claimed.fetch_add(MIGRATION_CHUNK, std::memory_order_relaxed)
+    };
+
+    if (start >= array.Capacity) {
+      break;
+    }
+
+    const u64 end = std::min(start + MIGRATION_CHUNK, u64{array.Capacity});
+
+    for (u64 i = start; i < end; i++) {
+      migrate(array.Slots[static_cast<usize>(i)], *next);
+    }
+
+    array.Migrated.fetch_add(end - start, std::memory_order_acq_rel);
+  }
+
+  while (array.Migrated.load(std::memory_order_acquire) < array.Capacity) {
+    std::this_thread::yield();
+  }
+
+  // any helper may be the one to switch, the others find it done
+  Array* expected = &array;
+  current.compare_exchange_strong(expected, next, std::memory_order_acq_rel);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::migrate(Slot& slot, Array& next) -> void {
+  u64 word = settled(slot);
+
+  // an empty slot is closed for inserts, whichever thread gets there first
+  while (state_of(word) == EMPTY) {
+    if (slot.Control.compare_exchange_strong(
+          word,
+          control(0, MOVED),
+          std::memory_order_acq_rel,
+          std::memory_order_acquire
+        )) {
+      return;
+    }
+
+    word = settled(slot);
+  }
+
+  // this thread owns the chunk and a full slot never changes otherwise
+  Node* item = slot.Item.load(std::memory_order_relaxed);
+  const u32 hash = hash_of(word);
+  u32 index = home(next, hash);
+
+  // only the helpers write to next before it is current, and each of them
+  // has different keys to place
+  for (;;) {
+    Slot& to = next.Slots[index];
+    u64 empty = control(0, EMPTY);
+
+    if (to.Control.compare_exchange_strong(
+          empty,
+          control(hash, BUSY),
+          std::memory_order_acq_rel,
+          std::memory_order_relaxed
+        )) {
+      to.Item.store(item, std::memory_order_relaxed);
+      to.Control.store(control(hash, FULL), std::memory_order_release);
+      break;
+    }
+
+    index = index + 1 == next.Capacity ? 0 : index + 1;
+  }
+
+  slot.Control.store(control(hash, MOVED), std::memory_order_release);
+}
+
+template<typename T>
+auto LockFreeOAHashTable<T>::overloaded(const Array& array) const -> bool {
+  return static_cast<f64>(size()) / array.Capacity > config.MaxLoadFactor_;
+}
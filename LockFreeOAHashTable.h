@@ -0,0 +1,195 @@
+//---------------------------------------------------------------------------
+#ifndef LOCKFREEOAHASHTABLEH
+#define LOCKFREEOAHASHTABLEH
+//---------------------------------------------------------------------------
+
+#include "OAHashTable.h"
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief How many slots a thread helping a LockFreeOAHashTable resize
+ * migrates at a time
+ */
+const u32 MIGRATION_CHUNK = 1024;
+
+/**
+ * @brief Number of separately cached counters a LockFreeOAHashTable spreads
+ * its item count over
+ */
+const usize COUNT_STRIPES = 16;
+
+//! Open addressing table that any number of threads insert into and search
+//! at the same time, without locks.
+//!
+//! Every slot has an atomic control word holding its state and the hash of
+//! its key. Inserts claim an empty slot with compare-and-swap, then publish
+//! the item (an immutable node holding the key and data) by storing the word
+//! again. Lookups only load.
+//!
+//! When the table has to grow, the thread that notices allocates the new
+//! slot array and every thread that runs into the resize helps move the
+//! slots over, a chunk at a time, before it carries on. Lookups keep working
+//! on the old array meanwhile and follow items to the new one.
+//!
+//! There is no removal: items stay until the table is destroyed, so lookups
+//! can hand out pointers and nothing has to wait for readers before being
+//! freed. The slot arrays from before each resize are kept as well (for a
+//! GrowthFactor_ of 2 they add up to less than the current one).
+//! Only InitialTableSize_, PrimaryHashFunc_, MaxLoadFactor_, GrowthFactor_
+//! and FreeProc_ (called on every item when the table is destroyed, and on
+//! data that lost an insert race, see try_emplace) of the config are used,
+//! probing is linear
+template<typename T>
+class LockFreeOAHashTable {
+public:
+
+  using OAHTConfig = typename OAHashTable<T>::OAHTConfig;
+
+  explicit LockFreeOAHashTable(const OAHTConfig& config);
+
+  // No other thread may still be using the table
+  ~LockFreeOAHashTable();
+
+  LockFreeOAHashTable(const LockFreeOAHashTable&) = delete;
+  auto operator=(const LockFreeOAHashTable&) -> LockFreeOAHashTable& = delete;
+
+  // The same as in OAHashTable, safe from any number of threads. When two
+  // threads insert the same key, exactly one of them gets S_OK. The data of
+  // the other may already have been moved from by then, it then goes to
+  // FreeProc_
+  auto insert(const char* key, const T& data) -> void;
+
+  auto insert(const char* key, T&& data) -> void;
+
+  template<typename... Args>
+  auto emplace(const char* key, Args&&... args) -> void;
+
+  auto try_insert(const char* key, const T& data) -> OAHTStatus;
+
+  auto try_insert(const char* key, T&& data) -> OAHTStatus;
+
+  template<typename... Args>
+  auto try_emplace(const char* key, Args&&... args) -> OAHTStatus;
+
+  // The data stays where it is for as long as the table lives
+  auto find(const char* key) const -> const T&;
+
+  auto try_find(const char* key) const -> const T*;
+
+  // Count_, TableSize_ and Expansions_, probes are not counted
+  auto GetStats() const -> OAHTStats;
+
+  // May lag behind inserts that are still running
+  auto size() const -> u32;
+
+  auto capacity() const -> u32;
+
+private:
+
+  struct Node {
+    template<typename... Args>
+    Node(u32 hash, Args&&... args):
+        Data(std::forward<Args>(args)...),
+        Hash{hash} {}
+
+    // the key is allocated right behind the node
+    auto key() const -> const char* {
+      return reinterpret_cast<const char*>(this + 1);
+    }
+
+    T Data;
+    u32 Hash;
+  };
+
+  // The low bits of a control word, the hash of the key is in the high half
+  enum SlotState : u64 {
+    EMPTY,  // never used
+    BUSY,   // claimed, Item is being set
+    FULL,   // Item is set
+    MOVED   // copied to the next array (Item is null if it was EMPTY)
+  };
+
+  struct Slot {
+    std::atomic<u64> Control{EMPTY};
+    std::atomic<Node*> Item{nullptr};
+  };
+
+  struct Array {
+    explicit Array(u32 capacity):
+        Capacity{capacity},
+        Slots{new Slot[capacity]{}} {}
+
+    u32 Capacity;
+    std::unique_ptr<Slot[]> Slots;
+
+    std::atomic<Array*> Next{nullptr}; // set once a resize starts
+    std::atomic<bool> Growing{false};  // taken by whoever allocates Next
+    std::atomic<u64> Claimed{0};       // slots handed out to migrate
+    std::atomic<u64> Migrated{0};      // slots done migrating
+  };
+
+  struct Counter {
+    std::atomic<u64> Value{0};
+    char Padding[64 - sizeof(std::atomic<u64>)];
+  };
+
+  static auto control(u32 hash, SlotState state) -> u64;
+
+  static auto state_of(u64 control) -> SlotState;
+
+  static auto hash_of(u64 control) -> u32;
+
+  // Waits out an insert that claimed the slot, returns its final word
+  static auto settled(const Slot& slot) -> u64;
+
+  auto hash(const char* key) const -> u32;
+
+  // First slot probed for hash in array
+  static auto home(const Array& array, u32 hash) -> u32;
+
+  // Where this thread counts its inserts
+  static auto stripe() -> usize;
+
+  template<typename... Args>
+  auto make_node(const char* key, u32 hash, Args&&... args) -> Node*;
+
+  static auto free_node(Node* node) -> void;
+
+  // Inserts into array, building node from args once a free slot turns up.
+  // Returns false if array is being resized, the insert then starts over on
+  // the next one (with the same node)
+  template<typename... Args>
+  auto place(
+    Array& array,
+    const char* key,
+    u32 hash,
+    Node*& node,
+    OAHTStatus& status,
+    Args&&... args
+  ) -> bool;
+
+  // Starts the resize of array unless another thread already has
+  auto grow(Array& array) -> void;
+
+  // Moves chunks of array to its Next until none are left, then waits for
+  // the other helpers and makes Next the current array
+  auto help_migrate(Array& array) -> void;
+
+  auto migrate(Slot& slot, Array& next) -> void;
+
+  // Whether inserts have gone past MaxLoadFactor_
+  auto overloaded(const Array& array) const -> bool;
+
+  OAHTConfig config;
+
+  Array* first{nullptr}; // owns the chain of arrays through Next
+  std::atomic<Array*> current{nullptr};
+
+  std::unique_ptr<Counter[]> counts{new Counter[COUNT_STRIPES]{}};
+  std::atomic<u32> expansions{0};
+};
+
+#include "LockFreeOAHashTable.cpp"
+
+#endif
@@ -5,69 +5,168 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <new>
 #include <ostream>
+#include <system_error>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#if defined(__SSE2__) && !defined(OAHT_NO_SIMD)
+#include <immintrin.h>
+#endif
+
 // ============================================================================
 // Lifetime / Rule of 5 Semantics
 // ============================================================================
 
-template<typename T>
-OAHashTable<T>::OAHashTable(const OAHTConfig& config): config{config} {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::OAHashTable(
+  const OAHTConfig& config
+):
+    config{config},
+    hasher{make_hasher(config)} {
 
   stats.PrimaryHashFunc_ = config.PrimaryHashFunc_;
   stats.SecondaryHashFunc_ = config.SecondaryHashFunc_;
 
-  capacity() = config.InitialTableSize_;
+  // memory from an ALLOCFUNC must go back to its DEALLOCFUNC, and operator
+  // new to operator delete
+  if (not this->config.AllocFunc_ or not this->config.DeallocFunc_) {
+    this->config.AllocFunc_ = nullptr;
+    this->config.DeallocFunc_ = nullptr;
+  }
+
+  set_capacity(config.InitialTableSize_);
+
+  // strides only cover the whole table if it has a prime (or power of two)
+  // size from the start
+  if (config.CapacityPolicy_ == POWER_OF_TWO or double_hashing()) {
+    set_capacity(round_capacity(capacity()));
+  }
 
   // initialise table
-  slots.reset(new Slot[capacity()]{});
+  slots = make_slots(capacity());
+  hashes = make_hashes(capacity());
+
+  if (config.ControlBytes_) {
+    control = make_control(capacity());
+  }
 }
 
-template<typename T>
-OAHashTable<T>::OAHashTable(OAHashTable&& from):
-    config{std::exchange(from.config, {})},
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::OAHashTable(OAHashTable&& from):
     stats{std::exchange(from.stats, {})},
-    slots{std::exchange(from.slots, nullptr)} {}
+    config{from.config},
+    hasher{std::move(from.hasher)},
+    equal{std::move(from.equal)},
+    slots{std::exchange(from.slots, nullptr)},
+    control{std::exchange(from.control, nullptr)},
+    hashes{std::exchange(from.hashes, nullptr)},
+    modulo{from.modulo},
+    stride_modulo{from.stride_modulo},
+    draining{std::exchange(from.draining, nullptr)},
+    migrated{from.migrated},
+    keys{std::move(from.keys)},
+    compacted{from.compacted} {}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::OAHashTable(
+  const OAHashTable& from
+):
+    stats{from.stats},
+    config{from.config},
+    hasher{from.hasher},
+    equal{from.equal},
+    modulo{from.modulo},
+    stride_modulo{from.stride_modulo},
+    migrated{from.migrated},
+    compacted{from.compacted} {
+
+  // the slots keep their key offsets, so the arena is copied as it is
+  try {
+    const u32 capacity = from.capacity();
 
-template<typename T>
-OAHashTable<T>::OAHashTable(const OAHashTable& from):
-    config{from.config}, stats{from.stats} {
+    slots = make_slots(capacity);
+    std::copy(from.slots.get(), from.slots.get() + capacity, slots.get());
 
-  slots.reset(new Slot[from.capacity()]);
-  std::vector<T> a;
-  std::copy(from.slots, &from.slots[from.capacity()], slots);
-}
+    if (from.hashes) {
+      hashes = make_hashes(capacity);
+      std::copy(
+        from.hashes.get(),
+        from.hashes.get() + capacity,
+        hashes.get()
+      );
+    }
 
-template<typename T>
-auto OAHashTable<T>::operator=(OAHashTable&& from) -> OAHashTable& {
-  config = from.config;
-  stats = from.stats;
-  slots.reset(std::exchange(from.slots, nullptr));
-  return *this;
+    if (from.control) {
+      control = make_control(capacity);
+      std::memcpy(
+        control.get(),
+        from.control.get(),
+        capacity + OAHTControlGroup::Width - 1
+      );
+    }
+
+    if (from.draining) {
+      draining.reset(new OAHashTable(*from.draining));
+    }
+
+    keys = from.keys;
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
+  }
 }
 
-template<typename T>
-auto OAHashTable<T>::operator=(const OAHashTable& from) -> OAHashTable& {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::operator=(
+  OAHashTable&& from
+) -> OAHashTable& {
   if (&from == this) {
     return *this;
   }
 
+  // the items of this table go through FreeProc_ like on destruction
   clear();
 
+  stats = std::exchange(from.stats, {});
   config = from.config;
-  stats = from.stats;
+  hasher = std::move(from.hasher);
+  equal = std::move(from.equal);
+  slots = std::exchange(from.slots, nullptr);
+  control = std::exchange(from.control, nullptr);
+  hashes = std::exchange(from.hashes, nullptr);
+  modulo = from.modulo;
+  stride_modulo = from.stride_modulo;
+  draining = std::exchange(from.draining, nullptr);
+  migrated = std::exchange(from.migrated, 0);
+  keys = std::move(from.keys);
+  compacted = std::exchange(from.compacted, 0);
+  return *this;
+}
 
-  slots.reset(new Slot[capacity()]);
-  std::copy(from.slots, &from.slots[from.capacity()], slots);
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::operator=(
+  const OAHashTable& from
+) -> OAHashTable& {
+  if (&from == this) {
+    return *this;
+  }
 
-  return *this;
+  // copied before anything of this table is freed, so a failed copy leaves
+  // it as it was
+  OAHashTable copy{from};
+  return *this = std::move(copy);
 }
 
-template<typename T>
-OAHashTable<T>::~OAHashTable() {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::~OAHashTable() {
   clear();
 }
 
@@ -75,118 +174,314 @@ OAHashTable<T>::~OAHashTable() {
 // Public API
 // ============================================================================
 
-template<typename T>
-auto OAHashTable<T>::insert(const char* key, const T& data) -> void {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::insert(
+  const char* key,
+  const T& data
+) -> void {
+  emplace(key, data);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::insert(
+  const char* key,
+  T&& data
+) -> void {
+  emplace(key, std::move(data));
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+template<typename... Args>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::emplace(
+  const char* key,
+  Args&&... args
+) -> void {
+  if (try_emplace(key, std::forward<Args>(args)...) == S_DUPLICATE) {
+    throw OAHashTableException(
+      OAHashTableException::E_DUPLICATE,
+      "Duplicate key"
+    );
+  }
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_insert(
+  const char* key,
+  const T& data
+) -> OAHTStatus {
+  return try_emplace(key, data);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_insert(
+  const char* key,
+  T&& data
+) -> OAHTStatus {
+  return try_emplace(key, std::move(data));
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+template<typename... Args>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_emplace(
+  const char* key,
+  Args&&... args
+) -> OAHTStatus {
   grow_if_needed();
-  size()++;
+  migrate_step();
 
-  const usize hash1 = hash(key);
-  const usize stride = probe_stride(key);
+  if (find_draining(key)) {
+    return S_DUPLICATE;
+  }
 
-  for (usize i = 0; i < capacity(); i++) {
-    const usize index{(hash1 + i * stride) % capacity()};
-    Slot& slot{slots[index]};
+  return insert(make_lookup(key), std::forward<Args>(args)...);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+template<typename... Args>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::insert(
+  const lookup& key,
+  Args&&... args
+) -> OAHTStatus {
+  if (config.RobinHood_) {
+    return insert_robin_hood(key, std::forward<Args>(args)...);
+  }
+
+  // the key goes into the first tombstone on its probe sequence, but only
+  // an empty slot proves there is no live duplicate further along
+  usize target = capacity();
+  u32 distance = 0;
+  usize index = key.home;
+
+  for (usize i = 0; i < capacity(); i++, index = next(index, key.stride)) {
+    const Slot& slot{slots[index]};
 
     stats.Probes_++;
     if (slot.State == Slot::OCCUPIED) {
+      if (matches(index, key)) {
+        return S_DUPLICATE;
+      }
       continue;
     }
 
+    if (target == capacity()) {
+      target = index;
+      distance = static_cast<u32>(i);
+    }
+
     if (slot.State == Slot::UNOCCUPIED) {
-      slot.State = OAHashTable::Slot::OCCUPIED;
-      std::strncpy(slot.Key, key, MAX_KEYLEN - 1);
-      slot.Data = data;
-      return;
+      break;
     }
+  }
 
-    for (usize j = 1; j < capacity(); j++) {
-      stats.Probes_++;
-      if (slots[(hash1 + j * stride) % capacity()].State != Slot::DELETED) {
-        continue;
+  if (target == capacity()) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "No free slot on probe sequence"
+    );
+  }
+
+  Slot& slot{slots[target]};
+
+  // nothing is built until the key is known to be new
+  assign(slot.Data, std::forward<Args>(args)...);
+  store_key(slot, key);
+  set_state(target, Slot::OCCUPIED, key.fragment);
+  slot.ProbeLength = distance;
+  if (hashes) {
+    hashes[target] = key.hash;
+  }
+  size()++;
+  return S_OK;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+template<typename... Args>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::insert_robin_hood(
+  const lookup& key,
+  Args&&... args
+) -> OAHTStatus {
+  // nothing is built until the key is known to be new, which it is once
+  // it takes a slot or displaces another item
+  Slot carry{};
+  u64 carry_hash{0};
+  const auto build = [&] {
+    store_key(carry, key);
+    carry_hash = key.hash;
+    carry.State = Slot::OCCUPIED;
+    assign(carry.Data, std::forward<Args>(args)...);
+  };
+
+  u8 fragment = key.fragment;
+  usize stride = key.stride;
+  bool displaced = false;
+  usize index = key.home;
+
+  for (u32 distance = 0; distance < capacity(); distance++) {
+    Slot& slot{slots[index]};
+
+    stats.Probes_++;
+
+    // a tombstone closer to its home than we are cannot be on the probe
+    // sequence of a duplicate further along, so it is safe to reuse
+    const bool free = slot.State == Slot::UNOCCUPIED
+                   or (slot.State == Slot::DELETED
+                       and slot.ProbeLength < distance);
+
+    if (free) {
+      if (not displaced) {
+        build();
       }
-      if (slots[(hash1 + j * stride) % capacity()].key_matches(key)) {
-        throw OAHashTableException(
-          OAHashTableException::E_DUPLICATE,
-          "Duplicate key"
-        );
-      } else {
-        break;
+
+      set_state(index, Slot::OCCUPIED, fragment);
+      carry.ProbeLength = distance;
+      slot = std::move(carry);
+      if (hashes) {
+        hashes[index] = carry_hash;
       }
+      size()++;
+      return S_OK;
     }
 
-    slot.State = OAHashTable::Slot::OCCUPIED;
-    std::strncpy(slot.Key, key, MAX_KEYLEN - 1);
-    slot.Data = data;
-    return;
+    if (slot.State != Slot::OCCUPIED) {
+      index = next(index, stride);
+      continue;
+    }
+
+    if (not displaced and matches(index, key)) {
+      return S_DUPLICATE;
+    }
+
+    if (slot.ProbeLength < distance) {
+      if (not displaced) {
+        build();
+      }
+
+      // take the slot from the richer item and keep placing that one instead
+      carry.ProbeLength = distance;
+      std::swap(carry, slot);
+      if (hashes) {
+        std::swap(carry_hash, hashes[index]);
+      }
+
+      const u8 evicted = control ? control[index] : u8{0};
+      set_state(index, Slot::OCCUPIED, fragment);
+      fragment = evicted;
+
+      distance = carry.ProbeLength;
+      if (double_hashing()) {
+        stride = make_lookup(carry, carry_hash).stride;
+      }
+
+      displaced = true;
+    }
+
+    index = next(index, stride);
+  }
+
+  throw OAHashTableException(
+    OAHashTableException::E_NO_MEMORY,
+    "No free slot on probe sequence"
+  );
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::remove(const char* key)
+  -> void {
+  if (try_remove(key) == S_ITEM_NOT_FOUND) {
+    throw OAHashTableException(
+      OAHashTableException::E_ITEM_NOT_FOUND,
+      "Key not in table."
+    );
   }
 }
 
-template<typename T>
-auto OAHashTable<T>::remove(const char* key) -> void {
-  const u32 hash1 = hash(key);
-  const u32 stride = probe_stride(key);
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_remove(const char* key)
+  -> OAHTStatus {
+  // migrating can grow the key arena, so a miss leaves the table untouched
+  if (find_draining(key)) {
+    draining->try_remove(key);
+    stats.Probes_ += std::exchange(draining->stats.Probes_, 0);
+    size()--;
+    migrate_step();
+    return S_OK;
+  }
+
+  const lookup search = make_lookup(key);
+  usize index = search.home;
 
-  for (u32 i = 0; i < capacity(); i++) {
-    const u32 index{(hash1 + i * stride) % capacity()};
+  for (usize i = 0; i < capacity(); i++, index = next(index, search.stride)) {
     Slot& slot{slots[index]};
 
     stats.Probes_++;
     if (slot.State == Slot::UNOCCUPIED) {
-      throw OAHashTableException(
-        OAHashTableException::E_ITEM_NOT_FOUND,
-        "Key not in table."
-      );
-      return;
+      return S_ITEM_NOT_FOUND;
+    }
+
+    if (config.RobinHood_ and slot.ProbeLength < i) {
+      break;
     }
 
-    if (not slot.key_matches(key)) {
+    // a displaced item can end up past its own old tombstone, so only the
+    // probe length ends a Robin Hood search
+    if (config.RobinHood_ and slot.State == Slot::DELETED) {
+      continue;
+    }
+
+    if (not matches(index, search)) {
       continue;
     }
 
     if (slot.State == Slot::DELETED) {
-      throw OAHashTableException(
-        OAHashTableException::E_ITEM_NOT_FOUND,
-        "Key not in table."
-      );
+      return S_ITEM_NOT_FOUND;
     }
 
     if (config.FreeProc_) {
-      config.FreeProc_(slot.Data);
+      config.FreeProc_(std::move(slot.Data));
     }
 
     size()--;
-    if (config.DeletionPolicy_ == OAHTDeletionPolicy::MARK) {
-      slot.State = Slot::DELETED;
+    // a double hashed key may still get a stride of 1, but its neighbours
+    // don't, so only a linear probing table can shift them back
+    if (config.DeletionPolicy_ == OAHTDeletionPolicy::BACKSHIFT
+        and not double_hashing()) {
+      backshift(index);
+    } else if (config.DeletionPolicy_ != OAHTDeletionPolicy::PACK) {
+      set_state(index, Slot::DELETED);
     } else if (config.DeletionPolicy_ == OAHTDeletionPolicy::PACK) {
-      slot.State = Slot::UNOCCUPIED;
+      set_state(index, Slot::UNOCCUPIED);
 
-      for (u32 j = 1; j < capacity(); j++) {
-        const u32 k = (index + j) % capacity();
+      usize k = index;
+
+      for (usize j = 1; j < capacity(); j++) {
+        k = next(k, 1);
 
         if (slots[k].State != Slot::OCCUPIED) {
           break;
         }
 
-        slots[k].State = Slot::UNOCCUPIED;
+        set_state(k, Slot::UNOCCUPIED);
         size()--;
-        insert(slots[k].Key, slots[k].Data);
+        insert(
+          make_lookup(slots[k], stored_hash(hashes.get(), k)),
+          std::move(slots[k].Data)
+        );
       }
     }
-    return;
+    migrate_step();
+    return S_OK;
   }
 
-  throw OAHashTableException(
-    OAHashTableException::E_ITEM_NOT_FOUND,
-    "Key not in table."
-  );
+  return S_ITEM_NOT_FOUND;
 }
 
-template<typename T>
-auto OAHashTable<T>::find(const char* key) const -> const T& {
-  const Slot* slot = index_of(key).slot;
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::find(const char* key) const
+  -> const T& {
+  const T* data = try_find(key);
 
-  if (slot) {
-    return slot->Data;
+  if (data) {
+    return *data;
   }
 
   throw OAHashTableException(
@@ -195,13 +490,72 @@ auto OAHashTable<T>::find(const char* key) const -> const T& {
   );
 }
 
-template<typename T>
-auto OAHashTable<T>::clear() -> void {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::try_find(
+  const char* key
+) const -> const T* {
+  const Slot* slot = index_of(make_lookup(key)).slot;
+
+  if (not slot) {
+    slot = find_draining(key);
+  }
+
+  return slot ? &slot->Data : nullptr;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::find_many(
+  const char* const* wanted,
+  usize count,
+  const T** out
+) const -> usize {
+  lookup pending[FIND_MANY_WINDOW];
+  usize found = 0;
+
+  for (usize first = 0; first < count; first += FIND_MANY_WINDOW) {
+    const usize batch = std::min(count - first, FIND_MANY_WINDOW);
+
+    // hash the whole batch and start loading its slots before probing any
+    // of them, so that their cache misses overlap instead of queueing
+    for (usize i = 0; i < batch; i++) {
+      pending[i] = make_lookup(wanted[first + i]);
+      prefetch(pending[i]);
+    }
+
+    // the next batch has to read its keys to hash them
+    for (usize i = first + batch; i < std::min(count, first + 2 * batch); i++) {
+      __builtin_prefetch(wanted[i]);
+    }
+
+    for (usize i = 0; i < batch; i++) {
+      const Slot* slot = index_of(pending[i]).slot;
+
+      if (not slot) {
+        slot = find_draining(wanted[first + i]);
+      }
+
+      out[first + i] = slot ? &slot->Data : nullptr;
+      found += slot ? 1 : 0;
+    }
+  }
+
+  return found;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::clear() -> void {
+  if (draining) {
+    size() -= draining->size();
+    draining.reset();
+  }
 
-  for (usize i = 0; i < capacity() and size() > 0; i++) {
+  for (usize i = 0; i < capacity() and size() + tombstones() > 0; i++) {
     Slot& slot = slots[i];
+    const typename Slot::SlotState state = slot.State;
 
-    if (std::exchange(slot.State, Slot::UNOCCUPIED) != Slot::OCCUPIED) {
+    set_state(i, Slot::UNOCCUPIED);
+
+    if (state != Slot::OCCUPIED) {
       continue;
     }
 
@@ -211,50 +565,94 @@ auto OAHashTable<T>::clear() -> void {
       config.FreeProc_(std::move(slot.Data));
     }
   }
-  assert(empty());
+  assert(empty() and tombstones() == 0);
+
+  keys.clear();
+  compacted = 0;
 }
 
-// ============================================================================
-// Internal Buffer Manaagement
-// ============================================================================
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::reserve(u32 count) -> void {
+  if (capacity_for(count) > capacity()) {
+    rehash(capacity_for(count));
+  }
+}
 
-template<typename T>
-auto OAHashTable<T>::grow_if_needed() -> void {
-  const f32 load_factor{
-    static_cast<f32>(size() + 1) / static_cast<f32>(capacity())
-  };
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::rehash(u32 new_capacity)
+  -> void {
+  new_capacity = round_capacity(std::max(new_capacity, capacity_for(size())));
 
-  if (size() + 1 > capacity() or load_factor > config.MaxLoadFactor_) {
-    grow();
+  if (new_capacity > capacity()) {
+    stats.Expansions_++;
   }
+
+  finish_migration();
+  resize(new_capacity);
 }
 
-template<typename T>
-auto OAHashTable<T>::grow() -> void {
-  stats.Expansions_++;
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::insert_range(
+  const char* const* new_keys,
+  const T* values,
+  u32 count
+) -> void {
+  reserve(size() + count);
 
-  const u32 old_capacity = capacity();
+  for (u32 i = 0; i < count; i++) {
+    insert(new_keys[i], values[i]);
+  }
+}
 
-  capacity() = GetClosestPrime( //
-    static_cast<u32>(std::ceil(config.GrowthFactor_ * old_capacity))
-  );
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::build_parallel(
+  const char* const* new_keys,
+  const T* values,
+  u32 count,
+  const OAHTConfig& config,
+  u32 threads
+) -> OAHashTable {
+  OAHashTable table{config};
+  table.reserve(count);
+
+  if (threads <= 1 or table.capacity() < PARALLEL_GROW_MIN
+      or not table.splittable()) {
+    table.insert_range(new_keys, values, count);
+    return table;
+  }
 
-  const u32 old_size = std::exchange(size(), 0);
+  try {
+    table.insert_parallel(new_keys, values, count, threads);
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
+  }
+
+  return table;
+}
 
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::compact() -> void {
   try {
-    std::unique_ptr<Slot[]> old_slots{new Slot[capacity()]{}};
-    slots.swap(old_slots);
+    std::vector<char> packed{};
 
-    for (u32 i = 0; i < old_capacity and size() < old_size; i++) {
-      Slot& slot = old_slots[i];
+    // tombstones keep their keys, lookups still compare against them
+    for (usize i = 0; i < capacity(); i++) {
+      Slot& slot = slots[i];
 
-      if (slot.State != slot.OCCUPIED) {
+      if (slot.State == Slot::UNOCCUPIED or slot.Length < KeyCapacity) {
         continue;
       }
 
-      insert(slot.Key, slot.Data);
+      const char* key = &keys[slot.Offset];
+      slot.Offset = static_cast<OAHTOffset>(packed.size());
+      packed.insert(packed.end(), key, key + slot.Length + 1);
     }
 
+    keys.swap(packed);
+    compacted = keys.size();
   } catch (const std::bad_alloc&) {
     throw OAHashTableException(
       OAHashTableException::E_NO_MEMORY,
@@ -263,100 +661,1210 @@ auto OAHashTable<T>::grow() -> void {
   }
 }
 
-template<typename T>
-auto OAHashTable<T>::index_of(const char* key) const -> index_res {
-
-  const usize hash1 = hash(key);
-  const usize stride = probe_stride(key);
-  const usize capacity = this->capacity();
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::arena_size() const
+  -> usize {
+  return keys.size();
+}
 
-  for (usize i = 0; i < capacity; i += stride) {
-    const usize index{(hash1 + i) % capacity};
-    Slot& slot{slots[index]};
+// ============================================================================
+// Internal Buffer Manaagement
+// ============================================================================
 
-    stats.Probes_++;
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::grow_if_needed() -> void {
+  const f32 load_factor{
+    static_cast<f32>(size() + 1) / static_cast<f32>(capacity())
+  };
 
-    if (slot.State == Slot::UNOCCUPIED) {
-      return {nullptr, 0};
-    }
+  if (size() + 1 > capacity() or load_factor > config.MaxLoadFactor_) {
+    grow();
+    return;
+  }
 
-    if (slot.State == Slot::DELETED) {
-      if (slot.key_matches(key)) {
-        return {nullptr, 0};
-      }
-    }
+  const f32 used{
+    static_cast<f32>(size() + 1 + tombstones()) / static_cast<f32>(capacity())
+  };
 
-    if (slot.State != OAHashTable::Slot::OCCUPIED) {
-      continue;
-    }
+  // Robin Hood placement may skip every tombstone, so it relies on at least
+  // one slot staying empty
+  const bool full = size() + 1 + tombstones() >= capacity();
+
+  if (tombstones() > 0 and config.RobinHood_ and full) {
+    purge();
+  } else if (tombstones() > 0 and config.PurgeFactor_ > 0
+             and used > config.PurgeFactor_) {
+    purge();
+  } else if (keys.size() > 2 * std::max(compacted, usize{capacity()})) {
+    // keys of removed items are only dropped by compact(), don't let churn
+    // without growth pile them up
+    compact();
+  }
+}
 
-    if (slot.key_matches(key)) {
-      return {&slot, index};
-    }
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::capacity_for(
+  u32 count
+) const -> u32 {
+  // same test as grow_if_needed, which the last of count inserts must pass
+  u32 capacity = static_cast<u32>(std::ceil(count / config.MaxLoadFactor_));
+
+  while (capacity < count
+         or static_cast<f32>(count) / static_cast<f32>(capacity)
+              > config.MaxLoadFactor_) {
+    capacity++;
   }
 
-  return {nullptr, 0};
+  // a double hashing stride is reduced by capacity() - 1, which must leave
+  // room for a stride other than 0
+  return std::max(capacity, double_hashing() ? u32{3} : u32{2});
 }
 
-template<typename T>
-auto OAHashTable<T>::hash(const char* key) const -> u32 {
-  return config.PrimaryHashFunc_(key, capacity());
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::grow() -> void {
+  stats.Expansions_++;
+
+  const u32 new_capacity = round_capacity( //
+    static_cast<u32>(std::ceil(config.GrowthFactor_ * capacity()))
+  );
+
+  if (config.MigrationBatch_ == 0) {
+    resize(new_capacity);
+    return;
+  }
+
+  finish_migration();
+  start_migration(new_capacity);
 }
 
-template<typename T>
-auto OAHashTable<T>::Slot::key_matches(const char* key) const -> bool {
-  return std::strncmp(Key, key, MAX_KEYLEN) == 0;
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::purge() -> void {
+  stats.Purges_++;
+
+  finish_migration();
+  resize(capacity());
 }
 
-template<typename T>
-auto OAHashTable<T>::probe_stride(const char* key) const -> u32 {
-  if (config.SecondaryHashFunc_ == nullptr) {
-    return 1;
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::start_migration(
+  u32 new_capacity
+) -> void {
+  // the old slots become a table of their own that is only ever searched
+  // and drained from here on, MARK keeps its items from moving around
+  OAHTConfig parked{config};
+  parked.InitialTableSize_ = 1;
+  parked.DeletionPolicy_ = MARK;
+  parked.PurgeFactor_ = 0;
+  parked.MigrationBatch_ = 0;
+
+  // everything is allocated before anything moves, so running out of
+  // memory leaves the table as it was
+  std::unique_ptr<OAHashTable> parked_table{};
+  OAHTArray<Slot> new_slots{};
+  OAHTArray<u64> new_hashes{};
+  OAHTArray<u8> new_control{};
+
+  try {
+    parked_table.reset(new OAHashTable(parked));
+    new_slots = make_slots(new_capacity);
+    new_hashes = make_hashes(new_capacity);
+
+    if (config.ControlBytes_) {
+      new_control = make_control(new_capacity);
+    }
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
   }
 
-  return config.SecondaryHashFunc_(key, capacity() - 1) + 1;
+  draining = std::move(parked_table);
+  draining->hasher = hasher;
+  draining->slots = std::exchange(slots, std::move(new_slots));
+  draining->control = std::exchange(control, std::move(new_control));
+  draining->hashes = std::exchange(hashes, std::move(new_hashes));
+  draining->keys.swap(keys);
+  draining->compacted = std::exchange(compacted, 0);
+  draining->set_capacity(capacity());
+  draining->size() = size();
+  draining->tombstones() = std::exchange(tombstones(), 0);
+  migrated = 0;
+
+  set_capacity(new_capacity);
 }
 
-// ============================================================================
-// Getters
-// ============================================================================
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::migrate_step() -> void {
+  if (not draining) {
+    return;
+  }
 
-template<typename T>
-auto OAHashTable<T>::size() const -> u32 {
-  return stats.Count_;
+  const u32 end{
+    std::min(migrated + config.MigrationBatch_, draining->capacity())
+  };
+
+  for (; migrated < end and draining->size() > 0; migrated++) {
+    Slot& slot = draining->slots[migrated];
+
+    if (slot.State != Slot::OCCUPIED) {
+      continue;
+    }
+
+    // the item is already counted in size()
+    size()--;
+    insert(
+      make_lookup(
+        slot,
+        draining->key_of(slot),
+        stored_hash(draining->hashes.get(), migrated)
+      ),
+      std::move(slot.Data)
+    );
+
+    draining->set_state(migrated, Slot::DELETED);
+    draining->size()--;
+  }
+
+  if (migrated == draining->capacity() or draining->size() == 0) {
+    draining.reset();
+  }
 }
 
-template<typename T>
-auto OAHashTable<T>::capacity() const -> u32 {
-  return stats.TableSize_;
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::finish_migration() -> void {
+  while (draining) {
+    migrate_step();
+  }
 }
 
-template<typename T>
-auto OAHashTable<T>::size() -> u32& {
-  return stats.Count_;
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::find_draining(
+  const char* key
+) const -> Slot* {
+  if (not draining) {
+    return nullptr;
+  }
+
+  const index_res found = draining->index_of(draining->make_lookup(key));
+  stats.Probes_ += std::exchange(draining->stats.Probes_, 0);
+
+  return found.slot;
 }
 
-template<typename T>
-auto OAHashTable<T>::capacity() -> u32& {
-  return stats.TableSize_;
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::resize(u32 new_capacity)
+  -> void {
+  const u32 old_capacity = capacity();
+
+  set_capacity(new_capacity);
+
+  const u32 old_size = std::exchange(size(), 0);
+  tombstones() = 0;
+
+  try {
+    OAHTArray<Slot> old_slots{make_slots(capacity())};
+    OAHTArray<u64> old_hashes{make_hashes(capacity())};
+    slots.swap(old_slots);
+    hashes.swap(old_hashes);
+
+    if (config.ControlBytes_) {
+      control = make_control(capacity());
+    }
+
+    const bool parallel = config.GrowThreads_ > 1
+                      and old_capacity >= PARALLEL_GROW_MIN and splittable();
+
+    if (parallel) {
+      rehash_parallel(old_slots.get(), old_hashes.get(), old_capacity);
+    }
+
+    for (u32 i = 0; not parallel and i < old_capacity and size() < old_size;
+         i++) {
+      Slot& slot = old_slots[i];
+
+      if (slot.State != slot.OCCUPIED) {
+        continue;
+      }
+
+      // the arena stays put, so the key is not copied again
+      insert(
+        make_lookup(slot, stored_hash(old_hashes.get(), i)),
+        std::move(slot.Data)
+      );
+    }
+
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
+  }
+
+  compact();
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::rehash_parallel(
+  Slot* from,
+  const u64* from_hashes,
+  u32 from_capacity
+) -> void {
+  const usize workers = config.GrowThreads_;
+  std::vector<std::vector<placement>> moves(workers * workers);
+
+  OAHTRunParallel(workers, [&](usize w) {
+    const u32 first = static_cast<u32>(w * from_capacity / workers);
+    const u32 last = static_cast<u32>((w + 1) * from_capacity / workers);
+
+    for (u32 i = first; i < last; i++) {
+      if (from[i].State != Slot::OCCUPIED) {
+        continue;
+      }
+
+      const lookup key = make_lookup(from[i], stored_hash(from_hashes, i));
+      moves[w * workers + partition(key.home, workers)].push_back(
+        {i, static_cast<u32>(key.home), key.fragment}
+      );
+    }
+  });
+
+  place_parallel(from, from_hashes, moves, workers, true);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::insert_parallel(
+  const char* const* new_keys,
+  const T* values,
+  u32 count,
+  usize workers
+) -> void {
+  // the items are built in a slot array of their own first, then placed
+  // like the slots of a rehash
+  OAHTArray<Slot> from{make_slots(count)};
+  OAHTArray<u64> from_hashes{make_hashes(count)};
+  std::vector<std::vector<placement>> moves(workers * workers);
+
+  // where each worker writes its long keys into the arena
+  std::vector<usize> arena(workers + 1);
+
+  const auto first = [&](usize w) {
+    return static_cast<u32>(w * count / workers);
+  };
+
+  OAHTRunParallel(workers, [&](usize w) {
+    for (u32 i = first(w); i < first(w + 1); i++) {
+      const usize length = std::strlen(new_keys[i]);
+
+      if (length >= KeyCapacity) {
+        arena[w + 1] += length + 1;
+      }
+    }
+  });
+
+  arena[0] = keys.size();
+  for (usize w = 0; w < workers; w++) {
+    arena[w + 1] += arena[w];
+  }
+
+  if (arena[workers] > MAX_KEY_ARENA) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "Key arena is full"
+    );
+  }
+
+  keys.resize(arena[workers]);
+
+  OAHTRunParallel(workers, [&](usize w) {
+    usize offset = arena[w];
+
+    for (u32 i = first(w); i < first(w + 1); i++) {
+      const lookup key = make_lookup(new_keys[i]);
+      const usize inline_length = std::min<usize>(key.length, KeyCapacity - 1);
+      Slot& slot = from[i];
+
+      if (key.length >= KeyCapacity) {
+        std::memcpy(&keys[offset], key.key, key.length + usize{1});
+        slot.Offset = static_cast<OAHTOffset>(offset);
+        offset += key.length + usize{1};
+      }
+
+      std::memcpy(slot.Key, key.key, inline_length);
+      slot.Key[inline_length] = '\0';
+      slot.Length = key.length;
+      assign(slot.Data, values[i]);
+
+      if (from_hashes) {
+        from_hashes[i] = key.hash;
+      }
+
+      moves[w * workers + partition(key.home, workers)].push_back(
+        {i, static_cast<u32>(key.home), key.fragment}
+      );
+    }
+  });
+
+  place_parallel(from.get(), from_hashes.get(), moves, workers, false);
+  compacted = keys.size();
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::place_parallel(
+  Slot* from,
+  const u64* from_hashes,
+  const std::vector<std::vector<placement>>& moves,
+  usize workers,
+  bool distinct
+) -> void {
+  std::vector<std::vector<u32>> spilled(workers);
+  std::vector<u32> placed(workers);
+  std::vector<u32> probes(workers);
+  std::vector<u32> repeated(workers);
+
+  // items placed before a worker threw are in the table all the same
+  const auto count = [&] {
+    for (usize p = 0; p < workers; p++) {
+      size() += placed[p];
+      stats.Probes_ += probes[p];
+    }
+  };
+
+  try {
+    OAHTRunParallel(workers, [&](usize p) {
+      const usize end = partition_start(p + 1, workers);
+
+      for (usize w = 0; w < workers; w++) {
+        for (const placement& item : moves[w * workers + p]) {
+          const Slot& source = from[item.from];
+          const lookup key{
+            key_of(source),
+            stored_hash(from_hashes, item.from),
+            source.Length
+          };
+          usize index = item.home;
+          bool duplicate = false;
+
+          // a repeated key has the same home: it is either in this cluster
+          // or was spilled, in which case this one spills too
+          for (; index < end and slots[index].State != Slot::UNOCCUPIED;
+               index++) {
+            if (not distinct and matches(index, key)) {
+              duplicate = true;
+              break;
+            }
+          }
+
+          // the other items are still placed (and counted), so that the table
+          // hands every item it took to FreeProc_ when it is destroyed
+          if (duplicate) {
+            repeated[p]++;
+            continue;
+          }
+
+          // the cluster runs into the next partition
+          if (index == end) {
+            spilled[p].push_back(item.from);
+            continue;
+          }
+
+          Slot& slot = slots[index];
+
+          // the arena stays put, so the key is not copied again
+          slot = std::move(from[item.from]);
+          slot.ProbeLength = static_cast<u32>(index - item.home);
+          set_state(index, Slot::OCCUPIED, item.fragment);
+          if (hashes) {
+            hashes[index] = key.hash;
+          }
+
+          placed[p]++;
+          probes[p] += static_cast<u32>(index - item.home + 1);
+        }
+      }
+    });
+  } catch (...) {
+    count();
+    throw;
+  }
+  count();
+
+  bool duplicate = false;
+
+  for (usize p = 0; p < workers; p++) {
+    duplicate = duplicate or repeated[p] > 0;
+  }
+
+  for (const std::vector<u32>& items : spilled) {
+    for (const u32 i : items) {
+      const OAHTStatus status{
+        insert(
+          make_lookup(from[i], stored_hash(from_hashes, i)),
+          std::move(from[i].Data)
+        )
+      };
+
+      duplicate = duplicate or status == S_DUPLICATE;
+    }
+  }
+
+  if (duplicate) {
+    throw OAHashTableException(
+      OAHashTableException::E_DUPLICATE,
+      "Duplicate key"
+    );
+  }
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::partition(
+  usize index,
+  usize workers
+) const -> usize {
+  return static_cast<usize>(u64{index} * workers / capacity());
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::partition_start(
+  usize p,
+  usize workers
+) const -> usize {
+  // rounded up, so partition() never puts an index before its start
+  return static_cast<usize>((u64{p} * capacity() + workers - 1) / workers);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::splittable() const
+  -> bool {
+  // only the clusters of linear probing stay near where they start
+  return not config.RobinHood_ and not double_hashing();
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::prefetch(
+  const lookup& key
+) const -> void {
+  // most hits are on one of the first two probes. A slot need not start on
+  // a cache line, so touch both of its ends
+  const usize probes[]{key.home, next(key.home, key.stride)};
+
+  for (const usize index : probes) {
+    const char* slot = reinterpret_cast<const char*>(&slots[index]);
+
+    __builtin_prefetch(slot);
+    __builtin_prefetch(slot + sizeof(Slot) - 1);
+  }
+
+  if (control) {
+    __builtin_prefetch(&control[key.home]);
+  }
+
+  // a probe compares the stored hash before it looks at the key
+  if (hashes) {
+    __builtin_prefetch(&hashes[key.home]);
+  }
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::index_of(
+  const lookup& key
+) const -> index_res {
+  if (control) {
+    return index_of_control(key);
+  }
+
+  const usize capacity = this->capacity();
+  usize index = key.home;
+
+  for (usize i = 0; i < capacity; i++, index = next(index, key.stride)) {
+    Slot& slot{slots[index]};
+
+    stats.Probes_++;
+
+    if (slot.State == Slot::UNOCCUPIED) {
+      return {nullptr, 0};
+    }
+
+    if (config.RobinHood_ and slot.ProbeLength < i) {
+      return {nullptr, 0};
+    }
+
+    if (slot.State == Slot::DELETED and not config.RobinHood_) {
+      if (matches(index, key)) {
+        return {nullptr, 0};
+      }
+    }
+
+    if (slot.State != OAHashTable::Slot::OCCUPIED) {
+      continue;
+    }
+
+    if (matches(index, key)) {
+      return {&slot, index};
+    }
+  }
+
+  return {nullptr, 0};
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::index_of_control(
+  const lookup& key
+) const -> index_res {
+  using Group = OAHTControlGroup;
+
+  const usize capacity = this->capacity();
+  const u8 h2 = key.fragment;
+
+  // double hashing (or a table smaller than a group) has no consecutive run
+  // of slots to match, so test one control byte per probe instead
+  if (key.stride != 1 or capacity < Group::Width) {
+    usize index = key.home;
+
+    for (usize i = 0; i < capacity; i++, index = next(index, key.stride)) {
+
+      stats.Probes_++;
+
+      if (control[index] == CONTROL_EMPTY) {
+        return {nullptr, 0};
+      }
+
+      if (control[index] == h2 and matches(index, key)) {
+        return {&slots[index], index};
+      }
+    }
+
+    return {nullptr, 0};
+  }
+
+  usize index = key.home;
+
+  for (usize probed = 0; probed < capacity;) {
+    const Group group{&control[index]};
+
+    // slots past the end of the table are mirrored, but must not be probed
+    // twice once we are near the end of the probe sequence
+    const usize window = std::min(usize{Group::Width}, capacity - probed);
+    const u32 in_window{
+      window == 32 ? ~u32{0} : (u32{1} << window) - 1 //
+    };
+
+    const u32 empty = group.match_empty() & in_window;
+    const usize stop{
+      empty ? static_cast<usize>(__builtin_ctz(empty)) : window //
+    };
+
+    for (u32 match = group.match(h2) & in_window; match; match &= match - 1) {
+      const usize offset = static_cast<usize>(__builtin_ctz(match));
+
+      if (offset > stop) {
+        break;
+      }
+
+      const usize found = next(index, offset);
+
+      if (matches(found, key)) {
+        stats.Probes_ += static_cast<u32>(offset + 1);
+        return {&slots[found], found};
+      }
+    }
+
+    if (empty) {
+      stats.Probes_ += static_cast<u32>(stop + 1);
+      return {nullptr, 0};
+    }
+
+    stats.Probes_ += static_cast<u32>(window);
+    probed += window;
+    index = next(index, window);
+  }
+
+  return {nullptr, 0};
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_lookup(
+  const char* key
+) const -> lookup {
+  if (config.DigestFunc_) {
+    return locate(
+      key,
+      config.DigestFunc_(key),
+      static_cast<u32>(std::strlen(key))
+    );
+  }
+
+  if (not config.StoreHashes_) {
+    // the client function already returns a slot index
+    const u32 home = hash(key);
+    lookup result{key, 0, static_cast<u32>(std::strlen(key))};
+    result.home = home;
+    result.stride = probe_stride(key);
+
+    // the client hash is all there is: keys with the same home share a
+    // fragment, the ones from other homes probing through are told apart
+    result.fragment = static_cast<u8>(OAHTMixHash(home) >> 25);
+    return result;
+  }
+
+  const u64 primary = hasher.primary(key, FULL_HASH_RANGE);
+  const u64 secondary = hasher.has_secondary()
+                        ? hasher.secondary(key, FULL_HASH_RANGE)
+                        : 0;
+
+  return locate(
+    key,
+    primary << 32 | secondary,
+    static_cast<u32>(std::strlen(key))
+  );
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_lookup(
+  const Slot& slot,
+  u64 hash
+) const -> lookup {
+  return make_lookup(slot, key_of(slot), hash);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_lookup(
+  const Slot& slot,
+  const char* key,
+  u64 hash
+) const -> lookup {
+  if (not config.StoreHashes_) {
+    return make_lookup(key);
+  }
+
+  return locate(key, hash, slot.Length);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::stored_hash(
+  const u64* hashes,
+  usize index
+) -> u64 {
+  return hashes ? hashes[index] : 0;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::locate(
+  const char* key,
+  u64 hash,
+  u32 length
+) const -> lookup {
+  // built in place, copying a half-written lookup around stalls every load
+  // of it on store forwarding
+  lookup result{key, hash, length};
+
+  result.home = reduce(static_cast<u32>(hash >> 32));
+
+  if (double_hashing() and config.CapacityPolicy_ == POWER_OF_TWO) {
+    result.stride = (static_cast<u32>(hash) & (capacity() - 1)) | 1;
+  } else if (double_hashing()) {
+    result.stride = stride_modulo(static_cast<u32>(hash)) + usize{1};
+  }
+
+  // the low bits of weak client hashes are all the table ever sees, so mix
+  // before taking the fragment from the top
+  result.fragment = static_cast<u8>((hash * 0x9E3779B97F4A7C15ull) >> 57);
+
+  return result;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::matches(
+  usize index,
+  const lookup& key
+) const -> bool {
+  const Slot& slot{slots[index]};
+
+  if ((hashes and hashes[index] != key.hash) or slot.Length != key.length) {
+    return false;
+  }
+
+  return equal(key_of(slot), key.key);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::assign(
+  T& data,
+  const T& value
+) -> void {
+  data = value;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::assign(T& data, T&& value)
+  -> void {
+  // PACK may put an item back into the slot it is moved out of
+  if (&data != &value) {
+    data = std::move(value);
+  }
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+template<typename... Args>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::assign(
+  T& data,
+  Args&&... args
+) -> void {
+  data = T(std::forward<Args>(args)...);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::key_of(
+  const Slot& slot
+) const -> const char* {
+  return slot.Length < KeyCapacity ? slot.Key : &keys[slot.Offset];
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::store_key(
+  Slot& slot,
+  const lookup& key
+) -> void {
+  if (key.length >= KeyCapacity) {
+    const std::less<const char*> before{};
+    const char* arena = keys.data();
+
+    if (not before(key.key, arena) and before(key.key, arena + keys.size())) {
+      // rehoming a slot of this table, its key is already in the arena
+      slot.Offset = static_cast<OAHTOffset>(key.key - arena);
+    } else if (keys.size() + key.length + 1 > MAX_KEY_ARENA) {
+      throw OAHashTableException(
+        OAHashTableException::E_NO_MEMORY,
+        "Key arena is full"
+      );
+    } else {
+      slot.Offset = static_cast<OAHTOffset>(keys.size());
+      keys.insert(keys.end(), key.key, key.key + key.length + 1);
+    }
+  }
+
+  const usize inline_length = std::min<usize>(key.length, KeyCapacity - 1);
+
+  std::memmove(slot.Key, key.key, inline_length);
+  slot.Key[inline_length] = '\0';
+  slot.Length = key.length;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::backshift(usize index)
+  -> void {
+  usize hole = index;
+  usize k = index;
+
+  for (usize j = 1; j < capacity(); j++) {
+    k = next(k, 1);
+
+    if (slots[k].State != Slot::OCCUPIED) {
+      break;
+    }
+
+    // Robin Hood clusters are ordered by home, nothing past an item that
+    // sits at its home can move in front of it
+    if (config.RobinHood_ and slots[k].ProbeLength == 0) {
+      break;
+    }
+
+    // the item may fill the hole unless its home lies between the hole and
+    // where it sits now, in which case it must stay reachable from there
+    const usize gap = k >= hole ? k - hole : k + capacity() - hole;
+
+    if (slots[k].ProbeLength >= gap) {
+      relocate(k, hole);
+      slots[hole].ProbeLength -= static_cast<u32>(gap);
+      hole = k;
+    }
+  }
+
+  set_state(hole, Slot::UNOCCUPIED);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::relocate(
+  usize from,
+  usize to
+) -> void {
+  slots[to] = std::move(slots[from]);
+  if (hashes) {
+    hashes[to] = hashes[from];
+  }
+  set_state(to, Slot::OCCUPIED, control ? control[from] : u8{0});
+  set_state(from, Slot::UNOCCUPIED);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::set_state(
+  usize index,
+  typename Slot::SlotState state,
+  u8 fragment
+) -> void {
+  if (slots[index].State == Slot::DELETED) {
+    tombstones()--;
+  }
+
+  if (state == Slot::DELETED) {
+    tombstones()++;
+  }
+
+  slots[index].State = state;
+
+  if (not control) {
+    return;
+  }
+
+  u8 byte = fragment;
+  if (state == Slot::UNOCCUPIED) {
+    byte = CONTROL_EMPTY;
+  } else if (state == Slot::DELETED) {
+    byte = CONTROL_DELETED;
+  }
+
+  control[index] = byte;
+
+  if (index < OAHTControlGroup::Width - 1) {
+    control[capacity() + index] = byte;
+  }
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_control(u32 capacity)
+  const -> OAHTArray<u8> {
+  const usize length = capacity + OAHTControlGroup::Width - 1;
+
+  OAHTArray<u8> control{
+    OAHTAllocate<u8>(length, config.AllocFunc_, config.DeallocFunc_)
+  };
+  std::memset(control.get(), CONTROL_EMPTY, length);
+
+  return control;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_slots(usize count)
+  const -> OAHTArray<Slot> {
+  return OAHTAllocate<Slot>(count, config.AllocFunc_, config.DeallocFunc_);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_hashes(usize count)
+  const -> OAHTArray<u64> {
+  if (not config.StoreHashes_) {
+    return nullptr;
+  }
+
+  return OAHTAllocate<u64>(count, config.AllocFunc_, config.DeallocFunc_);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_hasher(
+  const OAHTConfig& config
+) -> Hasher {
+  return make_hasher(
+    config,
+    std::is_constructible<Hasher, HASHFUNC, HASHFUNC>{}
+  );
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_hasher(
+  const OAHTConfig& config,
+  std::true_type
+) -> Hasher {
+  return Hasher(config.PrimaryHashFunc_, config.SecondaryHashFunc_);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::make_hasher(
+  const OAHTConfig&,
+  std::false_type
+) -> Hasher {
+  return Hasher{};
+}
+
+inline auto OAHTControlGroup::match(u8 fragment) const -> u32 {
+#if defined(__AVX2__) && !defined(OAHT_NO_SIMD)
+  const __m256i group =
+    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(control));
+  const __m256i needle = _mm256_set1_epi8(static_cast<char>(fragment));
+  return static_cast<u32>(
+    _mm256_movemask_epi8(_mm256_cmpeq_epi8(group, needle))
+  );
+#elif defined(__SSE2__) && !defined(OAHT_NO_SIMD)
+  const __m128i group =
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(control));
+  const __m128i needle = _mm_set1_epi8(static_cast<char>(fragment));
+  return static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, needle)));
+#else
+  u32 mask = 0;
+  for (usize i = 0; i < Width; i++) {
+    mask |= static_cast<u32>(control[i] == fragment) << i;
+  }
+  return mask;
+#endif
+}
+
+inline auto OAHTControlGroup::match_empty() const -> u32 {
+  return match(CONTROL_EMPTY);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::hash(const char* key) const
+  -> u32 {
+  return hasher.primary(key, capacity());
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::probe_stride(
+  const char* key
+) const -> u32 {
+  if (not hasher.has_secondary()) {
+    return 1;
+  }
+
+  const u32 stride = hasher.secondary(key, capacity() - 1) + 1;
+
+  // any odd stride is coprime with a power of two
+  if (config.CapacityPolicy_ == POWER_OF_TWO) {
+    return stride | 1;
+  }
+
+  return stride;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::double_hashing() const
+  -> bool {
+  return config.DigestFunc_ != nullptr or hasher.has_secondary();
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::round_capacity(
+  u32 requested
+) const -> u32 {
+  if (config.CapacityPolicy_ == PRIME) {
+    return GetClosestPrime(requested);
+  }
+
+  u32 capacity = 1;
+  while (capacity < requested) {
+    capacity <<= 1;
+  }
+
+  return capacity;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::set_capacity(u32 capacity)
+  -> void {
+  this->capacity() = capacity;
+
+  modulo = OAHTModulo{capacity};
+  stride_modulo = OAHTModulo{capacity > 1 ? capacity - 1 : 1};
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::reduce(u32 hash) const
+  -> usize {
+  if (config.CapacityPolicy_ == POWER_OF_TWO) {
+    return hash & (capacity() - 1);
+  }
+
+  return modulo(hash);
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::next(
+  usize index,
+  usize stride
+) const -> usize {
+  if (config.CapacityPolicy_ == POWER_OF_TWO) {
+    return (index + stride) & (capacity() - 1);
+  }
+
+  index += stride;
+  return index >= capacity() ? index - capacity() : index;
+}
+
+inline OAHTFunctionHasher::OAHTFunctionHasher(
+  HASHFUNC primary,
+  HASHFUNC secondary
+):
+    primary_hash{primary},
+    secondary_hash{secondary} {}
+
+inline auto OAHTFunctionHasher::primary(const char* key, u32 range) const
+  -> u32 {
+  return primary_hash(key, range);
+}
+
+inline auto OAHTFunctionHasher::secondary(const char* key, u32 range) const
+  -> u32 {
+  return secondary_hash(key, range);
+}
+
+inline auto OAHTFunctionHasher::has_secondary() const -> bool {
+  return secondary_hash != nullptr;
+}
+
+inline auto OAHTKeyEqual::operator()(const char* left, const char* right) const
+  -> bool {
+  return std::strcmp(left, right) == 0;
+}
+
+inline OAHTModulo::OAHTModulo(u32 divisor):
+    multiplier{~u64{0} / divisor + 1}, divisor{divisor} {}
+
+inline auto OAHTModulo::operator()(u32 value) const -> u32 {
+  const u64 fraction = multiplier * value;
+
+#if defined(__SIZEOF_INT128__)
+  return static_cast<u32>((static_cast<u128>(fraction) * divisor) >> 64);
+#else
+  // (fraction * divisor) >> 64 from two 32 bit halves, neither sum overflows
+  const u64 low = (fraction & 0xFFFFFFFF) * divisor;
+  const u64 high = (fraction >> 32) * divisor;
+
+  return static_cast<u32>((high + (low >> 32)) >> 32);
+#endif
+}
+
+inline auto OAHTMixHash(u32 hash) -> u32 {
+  // the high half of hash times 2^64 / golden ratio
+  return static_cast<u32>((hash * u64{0x9E3779B97F4A7C15}) >> 32);
+}
+
+inline auto OAHTRunParallel(
+  usize workers,
+  const std::function<void(usize)>& task
+) -> void {
+  std::vector<std::exception_ptr> errors(workers);
+  std::vector<std::thread> threads{};
+
+  const auto run = [&](usize worker) {
+    try {
+      task(worker);
+    } catch (...) {
+      errors[worker] = std::current_exception();
+    }
+  };
+
+  threads.reserve(workers);
+  for (usize worker = 1; worker < workers; worker++) {
+    try {
+      threads.emplace_back(run, worker);
+    } catch (const std::system_error&) {
+      // out of threads, do its share here instead
+      run(worker);
+    }
+  }
+
+  run(0);
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (const std::exception_ptr& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+template<typename Item>
+auto OAHTArrayDeleter<Item>::operator()(Item* items) const -> void {
+  for (usize i = count; i > 0; i--) {
+    items[i - 1].~Item();
+  }
+
+  if (deallocate) {
+    deallocate(items, count * sizeof(Item));
+  } else {
+    ::operator delete(items);
+  }
+}
+
+template<typename Item>
+auto OAHTAllocate(usize count, ALLOCFUNC allocate, DEALLOCFUNC deallocate)
+  -> OAHTArray<Item> {
+  const usize bytes = count * sizeof(Item);
+  Item* items = static_cast<Item*>(
+    allocate ? allocate(bytes) : ::operator new(bytes)
+  );
+
+  usize built = 0;
+
+  try {
+    for (; built < count; built++) {
+      new (&items[built]) Item{};
+    }
+  } catch (...) {
+    for (; built > 0; built--) {
+      items[built - 1].~Item();
+    }
+
+    if (deallocate) {
+      deallocate(items, bytes);
+    } else {
+      ::operator delete(items);
+    }
+    throw;
+  }
+
+  return OAHTArray<Item>{items, {deallocate, count}};
+}
+
+// ============================================================================
+// Getters
+// ============================================================================
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::size() const -> u32 {
+  return stats.Count_;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::capacity() const -> u32 {
+  return stats.TableSize_;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::size() -> u32& {
+  return stats.Count_;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::capacity() -> u32& {
+  return stats.TableSize_;
+}
+
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::tombstones() -> u32& {
+  return stats.Tombstones_;
 }
 
-template<typename T>
-auto OAHashTable<T>::GetStats() const -> OAHTStats {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::GetStats() const
+  -> OAHTStats {
   return stats;
 }
 
-template<typename T>
-auto OAHashTable<T>::GetTable() const -> const OAHTSlot* {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::GetTable() const
+  -> const OAHTSlot* {
   return slots.get();
 }
 
-template<typename T>
-auto OAHashTable<T>::load_factor() const -> f32 {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::load_factor() const -> f32 {
   return static_cast<f32>(size()) / static_cast<f32>(capacity());
 }
 
-template<typename T>
-auto OAHashTable<T>::empty() const -> bool {
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+auto OAHashTable<T, KeyCapacity, Hasher, KeyEqual>::empty() const -> bool {
   return size() == 0;
 }
@@ -4,10 +4,15 @@
 #ifndef OAHASHTABLEH
 #define OAHASHTABLEH
 
+#include "FastHash.h"
 #include "Support.h"
 #include <cstdint>
+#include <functional>
+#include <limits>
 #include <string>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 /**
  * @brief 32 Bit Floating Point Number
@@ -37,7 +42,7 @@ using u32 = std::uint32_t;
 /**
  * @brief Fix Sized Unsigned 64 Bit Integer (cannot be negative)
  */
-using u64 = unsigned long int;
+using u64 = std::uint64_t;
 
 /**
  * @brief Biggest Unsigned Integer type that the current platform can use
@@ -75,6 +80,14 @@ using i32 = std::int32_t;
  */
 using i64 = std::int64_t;
 
+#if defined(__SIZEOF_INT128__)
+/**
+ * @brief Unsigned 128 bit Integer (compiler extension, only used for the
+ * high half of 64 bit products, which have a fallback without it)
+ */
+__extension__ typedef unsigned __int128 u128;
+#endif
+
 /**
  * @brief Integer pointer typically used for pointer arithmetic
  */
@@ -86,9 +99,187 @@ returns an index in the table.
 */
 using HASHFUNC = u32 (*)(const char*, u32);
 
-//! Max length of our "string" keys
+/*!
+client-provided 64 bit hash function: takes a key, returns its full hash
+*/
+using DIGESTFUNC = u64 (*)(const char*);
+
+/*!
+client-provided allocator: takes a size in bytes, returns memory of that
+size aligned for any type (throws std::bad_alloc when out of memory)
+*/
+using ALLOCFUNC = void* (*)(usize);
+
+/*!
+client-provided deallocator: takes memory from the matching ALLOCFUNC and
+the size it was allocated with
+*/
+using DEALLOCFUNC = void (*)(void*, usize);
+
+//! Default inline storage for keys (including the terminating null), longer
+//! keys are kept out of line
 const usize MAX_KEYLEN = 32;
 
+/**
+ * @brief Default hasher of OAHashTable, calls the HASHFUNCs of its config
+ *
+ * Any type with the same three members can be used instead, and since it is
+ * a template argument its hashes can be inlined. Both hashes must be below
+ * range. Hashers that can be constructed from the primary and secondary
+ * HASHFUNC of the config are, anything else is default constructed.
+ */
+struct OAHTFunctionHasher {
+  OAHTFunctionHasher(HASHFUNC primary, HASHFUNC secondary);
+
+  auto primary(const char* key, u32 range) const -> u32;
+
+  auto secondary(const char* key, u32 range) const -> u32;
+
+  //! False for linear probing
+  auto has_secondary() const -> bool;
+
+private:
+
+  HASHFUNC primary_hash;
+  HASHFUNC secondary_hash;
+};
+
+/**
+ * @brief Default key comparison of OAHashTable, byte for byte
+ */
+struct OAHTKeyEqual {
+  auto operator()(const char* left, const char* right) const -> bool;
+};
+
+/**
+ * @brief Table size passed to the client hash functions when the table
+ * caches full hashes, so the result is not yet reduced to a slot index
+ */
+const u32 FULL_HASH_RANGE = 0xFFFFFFFF;
+
+/**
+ * @brief Where a key too long for its slot starts in the key arena of an
+ * OAHashTable
+ */
+using OAHTOffset = u32;
+
+/**
+ * @brief Most bytes the key arena of an OAHashTable holds, the end of every
+ * key in it must still be an OAHTOffset
+ */
+const usize MAX_KEY_ARENA = std::numeric_limits<OAHTOffset>::max();
+
+/**
+ * @brief How many keys find_many hashes (and prefetches the slots of) before
+ * it probes for any of them
+ */
+const usize FIND_MANY_WINDOW = 16;
+
+/**
+ * @brief Smallest table (in slots) that GrowThreads_ rehashes on more than
+ * one thread, starting threads costs more than rehashing anything smaller
+ */
+const u32 PARALLEL_GROW_MIN = 1 << 16;
+
+/**
+ * @brief Control byte for a slot that has never held an item
+ */
+const u8 CONTROL_EMPTY = 0x80;
+
+/**
+ * @brief Control byte for a slot whose item was removed (MARK policy)
+ */
+const u8 CONTROL_DELETED = 0xFE;
+
+/**
+ * @brief A group of consecutive control bytes that are matched at once,
+ * 32 at a time with AVX2, 16 with SSE2 and 8 otherwise
+ *
+ * Occupied slots store a 7 bit fragment of the key hash (high bit clear),
+ * so a single compare finds every candidate slot in the group. Defining
+ * OAHT_NO_SIMD matches 8 at a time with plain compares everywhere.
+ */
+struct OAHTControlGroup {
+#if defined(__AVX2__) && !defined(OAHT_NO_SIMD)
+  static constexpr usize Width = 32;
+#elif defined(__SSE2__) && !defined(OAHT_NO_SIMD)
+  static constexpr usize Width = 16;
+#else
+  static constexpr usize Width = 8;
+#endif
+
+  //! Loads Width control bytes starting at control
+  explicit OAHTControlGroup(const u8* control): control{control} {}
+
+  //! Bitmask of the bytes equal to fragment (bit i is byte i)
+  auto match(u8 fragment) const -> u32;
+
+  //! Bitmask of the bytes equal to CONTROL_EMPTY
+  auto match_empty() const -> u32;
+
+private:
+
+  const u8* control;
+};
+
+/**
+ * @brief Remainder by a fixed divisor without a divide instruction
+ *
+ * The multiplier is computed once per divisor, after which value % divisor
+ * is two multiplications for any 32 bit value (Lemire, Kaser & Kurz,
+ * "Faster Remainder by Direct Computation").
+ */
+struct OAHTModulo {
+  OAHTModulo() = default;
+
+  explicit OAHTModulo(u32 divisor);
+
+  //! value % divisor
+  auto operator()(u32 value) const -> u32;
+
+private:
+
+  u64 multiplier{0};
+  u32 divisor{1};
+};
+
+/**
+ * @brief Spreads a 32 bit hash over all of its bits (Fibonacci hashing)
+ *
+ * Tables that scale a hash to their capacity with (hash * capacity) >> 32
+ * only use its high bits, which a client hash function like a byte sum
+ * leaves at 0. Mixed, nearby hashes land far apart.
+ */
+auto OAHTMixHash(u32 hash) -> u32;
+
+/**
+ * @brief Runs task(0) to task(workers - 1) at the same time, task(0) on the
+ * calling thread, and rethrows the first exception any of them threw
+ */
+auto OAHTRunParallel(usize workers, const std::function<void(usize)>& task)
+  -> void;
+
+//! Destroys the items of an array from OAHTAllocate, then hands its memory
+//! back to the DEALLOCFUNC (operator delete if there is none)
+template<typename Item>
+struct OAHTArrayDeleter {
+  auto operator()(Item* items) const -> void;
+
+  DEALLOCFUNC deallocate{nullptr};
+  usize count{0};
+};
+
+template<typename Item>
+using OAHTArray = std::unique_ptr<Item[], OAHTArrayDeleter<Item>>;
+
+/**
+ * @brief count value-initialised items in memory from allocate (operator new
+ * if it is null), freed with deallocate
+ */
+template<typename Item>
+auto OAHTAllocate(usize count, ALLOCFUNC allocate, DEALLOCFUNC deallocate)
+  -> OAHTArray<Item>;
+
 //! The exception class for the hash table
 class OAHashTableException {
 
@@ -131,7 +322,23 @@ private:
 //! The policy used during a deletion
 enum OAHTDeletionPolicy {
   MARK,
-  PACK
+  PACK,
+  BACKSHIFT //!< Shifts the rest of the cluster back in place (linear probing
+            //!< only, double hashing falls back to MARK)
+};
+
+//! What the non-throwing operations (try_insert, try_remove) did, the
+//! counterparts of the OAHashTableException codes
+enum OAHTStatus {
+  S_OK,
+  S_ITEM_NOT_FOUND,
+  S_DUPLICATE
+};
+
+//! The sizes the table is allowed to take
+enum OAHTCapacityPolicy {
+  PRIME,       //!< Closest prime from GetClosestPrime, reduced with %
+  POWER_OF_TWO //!< Next power of two, reduced with a mask
 };
 
 //! OAHashTable statistical info
@@ -143,13 +350,27 @@ struct OAHTStats {
   u32 TableSize_{0};                    //!< Size of the table (total slots)
   u32 Probes_{0};                       //!< Number of probes performed
   u32 Expansions_{0};                   //!< Number of times the table grew
+  u32 Tombstones_{0};                   //!< Number of DELETED slots
+  u32 Purges_{0}; //!< Number of times tombstones were purged without growing
   HASHFUNC PrimaryHashFunc_{nullptr};   //!< Pointer to primary hash function
   HASHFUNC SecondaryHashFunc_{nullptr}; //!< Pointer to secondary hash function
 };
 
+template<typename T, usize KeyCapacity, typename Hasher, typename KeyEqual>
+class ConcurrentOAHashTable;
+
 //! Hash table definition (open-addressing)
-template<typename T>
+//! Keys shorter than KeyCapacity are stored inside the slot, longer ones in a
+//! key arena owned by the table (KeyCapacity 1 keeps every key there).
+//! Keys that are KeyEqual must get the same hashes from Hasher
+template<
+  typename T,
+  usize KeyCapacity = MAX_KEYLEN,
+  typename Hasher = OAHTFunctionHasher,
+  typename KeyEqual = OAHTKeyEqual>
 class OAHashTable {
+  static_assert(KeyCapacity > 0, "Slots need room for the null terminator");
+
 public:
 
   /**
@@ -159,10 +380,10 @@ public:
 
   //! Configuration for the hash table
   struct OAHTConfig {
-    //! Non-default constructor
+    //! Non-default constructor, hashes with FastHash unless told otherwise
     inline OAHTConfig(
       u32 initial_size,
-      HASHFUNC primary_hash,
+      HASHFUNC primary_hash = FastHash,
       HASHFUNC second_hash = nullptr,
       f64 max_load_factor = 0.5,
       f64 grow_factor = 2.0,
@@ -182,8 +403,59 @@ public:
     HASHFUNC SecondaryHashFunc_;        //!< Hash function to resolve collisions
     f64 MaxLoadFactor_;                 //!< Maximum LF before growing
     f64 GrowthFactor_;                  //!< The amount to grow the table
-    OAHTDeletionPolicy DeletionPolicy_; //!< MARK or PACK
+    OAHTDeletionPolicy DeletionPolicy_; //!< MARK, PACK or BACKSHIFT
     FREEPROC FreeProc_;                 //!< Client-provided free function
+
+    //! Mirror slot states in a dense control-byte array so lookups can
+    //! test a whole group of slots before touching any key
+    bool ControlBytes_{false};
+
+    //! Cache each key's full hash, in an array next to the slots, so growing
+    //! never calls the hash functions again and most key compares stop
+    //! early. The hash functions are called once with FULL_HASH_RANGE and
+    //! the table reduces the result itself. Without it the array is not
+    //! allocated and slots stay as small as they are
+    bool StoreHashes_{false};
+
+    //! PRIME or POWER_OF_TWO. Power of two tables reduce every probe with a
+    //! mask and force an odd stride so double hashing still visits every
+    //! slot
+    OAHTCapacityPolicy CapacityPolicy_{PRIME};
+
+    //! Robin Hood insertion: an item displaces any it passes that sit closer
+    //! to their home, which keeps probe lengths short at high load factors
+    //! and lets lookups stop at the first slot with a shorter probe length
+    bool RobinHood_{false};
+
+    //! Rehash in place (same capacity) once items plus tombstones would take
+    //! up more than this fraction of the table, 0 never purges
+    f64 PurgeFactor_{0.0};
+
+    //! Grow incrementally: the old slots are kept next to the new ones and
+    //! every insert/remove migrates this many of them, lookups check both
+    //! until migration is over. 0 migrates everything during grow()
+    u32 MigrationBatch_{0};
+
+    //! Hash every key once with this instead of the primary and secondary
+    //! hash functions: the high half of the digest picks the home slot and
+    //! the low half the stride, which is never 0 and always coprime with
+    //! the capacity
+    DIGESTFUNC DigestFunc_{nullptr};
+
+    //! Rehash on this many threads whenever the table is rebuilt in one go
+    //! (grow without MigrationBatch_, rehash, reserve, purge) and has at
+    //! least PARALLEL_GROW_MIN slots. Only linear probing without Robin Hood
+    //! is split up, any other table rehashes on the calling thread, as it
+    //! does for 0 or 1
+    u32 GrowThreads_{0};
+
+    //! Where the slot and control arrays come from, set both or neither
+    //! (new and delete, which a table also uses if only one of them is
+    //! set, as neither can free what the other allocated). HugePageAlloc
+    //! and HugePageFree (HugePages.h) put big tables on 2 MB pages, which
+    //! saves most of the TLB misses of lookups in tables of many gigabytes
+    ALLOCFUNC AllocFunc_{nullptr};
+    DEALLOCFUNC DeallocFunc_{nullptr};
   };
 
   //! The 3 possible states the slot can be in
@@ -198,24 +470,30 @@ public:
 
     using OAHTSlot_State = SlotState;
 
-    char Key[MAX_KEYLEN]{'\0'};  //!< Key is a string
+    char Key[KeyCapacity]{'\0'}; //!< Key, or its prefix if it is longer
     T Data;                      //!< Client data
     SlotState State{UNOCCUPIED}; //!< The state of the slot
-    i32 probes{0};               //!< For testing
-
-    auto key_matches(const char* key) const -> bool;
+    u32 ProbeLength{0};          //!< Probes past the home index
+    u32 Length{0};               //!< Length of the key
+    OAHTOffset Offset{0};        //!< Start of the key in the key arena
   };
 
   using OAHTSlot = Slot;
 
   OAHashTable(const OAHTConfig& Config); // Constructor
 
+  // The table moved from is left empty, only to be destroyed or assigned to
   OAHashTable(OAHashTable&& from);
 
+  // Copies every item, the slot layout, the key arena and the hasher, and
+  // the slots still being migrated from
   OAHashTable(const OAHashTable& from);
 
+  // The items of this table are freed (FreeProc_) first
   auto operator=(OAHashTable&& from) -> OAHashTable&;
 
+  // Like move assignment from a copy, this table is left as it was if the
+  // copy throws
   auto operator=(const OAHashTable& from) -> OAHashTable&;
 
   ~OAHashTable(); // Destructor
@@ -224,17 +502,82 @@ public:
   // insertion is unsuccessful.
   auto insert(const char* key, const T& data) -> void;
 
+  // Same, moving data into the table
+  auto insert(const char* key, T&& data) -> void;
+
+  // Same, with the data built from args. Slots always hold a T, so it is
+  // move assigned into its slot (assigned directly if args is just a T)
+  template<typename... Args>
+  auto emplace(const char* key, Args&&... args) -> void;
+
+  // The same three, returning S_DUPLICATE instead of throwing if the key is
+  // already in the table (running out of memory still throws)
+  auto try_insert(const char* key, const T& data) -> OAHTStatus;
+
+  auto try_insert(const char* key, T&& data) -> OAHTStatus;
+
+  template<typename... Args>
+  auto try_emplace(const char* key, Args&&... args) -> OAHTStatus;
+
   // Delete an item by key. Throws an exception if the key doesn't exist.
   // Compacts the table by moving key/data pairs, if necessary
   auto remove(const char* key) -> void;
 
+  // Same, returning S_ITEM_NOT_FOUND instead of throwing
+  auto try_remove(const char* key) -> OAHTStatus;
+
   // Find and return data by key. Throws an exception (E_ITEM_NOT_FOUND)
   // if not found.
   auto find(const char* key) const -> const T&;
 
+  // Same, returning nullptr if not found
+  auto try_find(const char* key) const -> const T*;
+
+  // try_find for count keys at once, out[i] is the data of wanted[i] or
+  // nullptr. The cache misses of up to FIND_MANY_WINDOW lookups overlap.
+  // Returns how many keys were found
+  auto find_many(const char* const* wanted, usize count, const T** out) const
+    -> usize;
+
   // Removes all items from the table (Doesn't deallocate table)
   auto clear() -> void;
 
+  // Grows the table (at most once) so that count items fit without any
+  // further growth. Never shrinks the table
+  auto reserve(u32 count) -> void;
+
+  // Rebuilds the table with at least the given capacity (rounded by the
+  // capacity policy), or more if the current items need it
+  auto rehash(u32 capacity) -> void;
+
+  // Rewrites the key arena without the keys of items that are gone.
+  // Happens on its own whenever the table is rebuilt
+  auto compact() -> void;
+
+  // Bytes in the key arena, keys of removed items included until they are
+  // compacted away
+  auto arena_size() const -> usize;
+
+  // Inserts count key/data pairs after sizing the table for all of them
+  // once. Throws like insert, pairs before the failing one stay inserted
+  auto insert_range(const char* const* new_keys, const T* values, u32 count)
+    -> void;
+
+  // Builds a table of count key/data pairs on the given number of threads:
+  // it is sized once, then the keys are hashed and the items placed in
+  // disjoint ranges of slots at the same time. The items are copied into a
+  // slot array of their own on the way, so building takes about twice the
+  // memory of the table. Tables that GrowThreads_ would not split, and
+  // tables below PARALLEL_GROW_MIN slots, are filled with insert_range.
+  // Throws like insert (E_DUPLICATE if a key repeats)
+  static auto build_parallel(
+    const char* const* new_keys,
+    const T* values,
+    u32 count,
+    const OAHTConfig& config,
+    u32 threads
+  ) -> OAHashTable;
+
   // Allow the client to peer into the data
   auto GetStats() const -> OAHTStats;
 
@@ -257,10 +600,149 @@ private: // Some suggestions (You don't have to use any of this.)
   // Expands the table when the load factor reaches a certain point
   // (greater than MaxLoadFactor) Grows the table by GrowthFactor,
   // making sure the new size is prime by calling GetClosestPrime
+  // (or a power of two, see CapacityPolicy_)
   auto grow() -> void;
 
+  // Smallest capacity allowed by the capacity policy that holds requested
+  // slots
+  auto round_capacity(u32 requested) const -> u32;
+
+  // Resizes the table and precomputes the reducers for the new capacity
+  auto set_capacity(u32 capacity) -> void;
+
+  // Maps a hash over FULL_HASH_RANGE onto a slot index
+  auto reduce(u32 hash) const -> usize;
+
+  // The index stride slots after index in a probe sequence (stride must be
+  // less than the capacity)
+  auto next(usize index, usize stride) const -> usize;
+
   auto grow_if_needed() -> void;
 
+  // Rehashes at the same capacity to drop every tombstone
+  auto purge() -> void;
+
+  // Moves every item into a fresh table of the given capacity
+  auto resize(u32 capacity) -> void;
+
+  // An item of from bound for the slots, as found by worker threads
+  struct placement {
+    u32 from;
+    u32 home;
+    u8 fragment;
+  };
+
+  // The rehash of resize on GrowThreads_ threads, see place_parallel
+  auto rehash_parallel(Slot* from, const u64* from_hashes, u32 from_capacity)
+    -> void;
+
+  // The parallel part of build_parallel, on an empty table
+  auto insert_parallel(
+    const char* const* new_keys,
+    const T* values,
+    u32 count,
+    usize workers
+  ) -> void;
+
+  // Moves items of from (with their from_hashes, if the table stores
+  // hashes) into the slots on workers threads: the slots are
+  // split into one partition per thread and each thread places the items
+  // whose home is in its partition, moves[w * workers + p] (found by
+  // worker w for partition p) in order. Items that would probe past the
+  // end of their partition are inserted on the calling thread afterwards.
+  // Unless distinct, every key is checked against the others: a repeated
+  // key is left out and E_DUPLICATE thrown once the rest are placed
+  auto place_parallel(
+    Slot* from,
+    const u64* from_hashes,
+    const std::vector<std::vector<placement>>& moves,
+    usize workers,
+    bool distinct
+  ) -> void;
+
+  // The partition of workers that index is in, and where partition p starts
+  auto partition(usize index, usize workers) const -> usize;
+
+  auto partition_start(usize p, usize workers) const -> usize;
+
+  // Whether the items stay near their home, so that rehashing can be split
+  // up: linear probing without Robin Hood
+  auto splittable() const -> bool;
+
+  auto tombstones() -> u32&;
+
+  // Smallest capacity that holds count items without exceeding
+  // MaxLoadFactor_, at least 2 (3 for double hashing)
+  auto capacity_for(u32 count) const -> u32;
+
+  // Parks the current slots in draining and starts over with an empty table
+  // of the given capacity
+  auto start_migration(u32 capacity) -> void;
+
+  // Moves the next MigrationBatch_ slots out of draining
+  auto migrate_step() -> void;
+
+  auto finish_migration() -> void;
+
+  // Looks up a key that has not been migrated yet
+  auto find_draining(const char* key) const -> Slot*;
+
+  // A key along with everything needed to probe for it, computed once per
+  // operation
+  struct lookup {
+    const char* key{nullptr};
+    u64 hash{0};     //!< Full hash (StoreHashes_ only)
+    u32 length{0};   //!< Length of key
+    usize home{0};   //!< First index of the probe sequence
+    usize stride{1}; //!< Distance between two probes
+    u8 fragment{0};  //!< Control byte for the key (ControlBytes_ only)
+  };
+
+  auto make_lookup(const char* key) const -> lookup;
+
+  // Reuses hash, the one cached for the slot, when the table stores them
+  auto make_lookup(const Slot& slot, u64 hash) const -> lookup;
+
+  // Same, for a slot whose key is stored elsewhere (another table's arena)
+  auto make_lookup(const Slot& slot, const char* key, u64 hash) const
+    -> lookup;
+
+  // The hash cached for slot index of an array, 0 if there is no hashes
+  static auto stored_hash(const u64* hashes, usize index) -> u64;
+
+  // Fills in the probe sequence of a key from its full hash
+  auto locate(const char* key, u64 hash, u32 length) const -> lookup;
+
+  // Whether the slot at index holds key
+  auto matches(usize index, const lookup& key) const -> bool;
+
+  // Starts loading the first slots (and control bytes and hashes) probed
+  // for a key
+  auto prefetch(const lookup& key) const -> void;
+
+  // The whole key of a slot
+  auto key_of(const Slot& slot) const -> const char*;
+
+  // Copies the key into the slot, moving it to the arena if it is too long
+  // for Key. The key may already live in that same slot or in the arena
+  auto store_key(Slot& slot, const lookup& key) -> void;
+
+  // Places a key, the table must already be big enough. The data is built
+  // from args, unless the key turns out to be a duplicate
+  template<typename... Args>
+  auto insert(const lookup& key, Args&&... args) -> OAHTStatus;
+
+  template<typename... Args>
+  auto insert_robin_hood(const lookup& key, Args&&... args) -> OAHTStatus;
+
+  // data = T(args...) without the temporary when args is a single T
+  static auto assign(T& data, const T& value) -> void;
+
+  static auto assign(T& data, T&& value) -> void;
+
+  template<typename... Args>
+  static auto assign(T& data, Args&&... args) -> void;
+
   struct index_res {
     Slot* slot{nullptr};
     usize index{0};
@@ -272,15 +754,72 @@ private: // Some suggestions (You don't have to use any of this.)
   // Returns the index of the item in the table
   // Sets Slot to point to the slot in the table where it belongs
   // Returns -1 if it's not in the table
-  auto index_of(const char* key) const -> index_res;
+  auto index_of(const lookup& key) const -> index_res;
 
   auto hash(const char* key) const -> u32;
 
   auto probe_stride(const char* key) const -> u32;
 
+  // Whether keys probe with a stride other than 1
+  auto double_hashing() const -> bool;
+
+  // index_of for tables that keep control bytes, matches a whole
+  // OAHTControlGroup per step when probing linearly
+  auto index_of_control(const lookup& key) const -> index_res;
+
+  // Empties the slot at index by moving every following entry of its cluster
+  // that may legally sit there one hole back (Knuth's Algorithm R)
+  // (linear probing only)
+  auto backshift(usize index) -> void;
+
+  // Moves an occupied slot into an unoccupied one
+  auto relocate(usize from, usize to) -> void;
+
+  // Updates the state of a slot along with its control byte (if any) and the
+  // tombstone count
+  auto set_state(usize index, typename Slot::SlotState state, u8 fragment = 0)
+    -> void;
+
+  // Allocates a control array for capacity slots, all marked empty.
+  // The first Width - 1 bytes are mirrored past the end so a group load
+  // never has to wrap around
+  auto make_control(u32 capacity) const -> OAHTArray<u8>;
+
+  // count empty slots from the allocator of the config
+  auto make_slots(usize count) const -> OAHTArray<Slot>;
+
+  // Room for the hashes of count slots, nullptr without StoreHashes_
+  auto make_hashes(usize count) const -> OAHTArray<u64>;
+
+  static auto make_hasher(const OAHTConfig& config) -> Hasher;
+
+  static auto make_hasher(const OAHTConfig& config, std::true_type) -> Hasher;
+
+  static auto make_hasher(const OAHTConfig& config, std::false_type)
+    -> Hasher;
+
+  // shards with the same hasher as its tables
+  friend class ConcurrentOAHashTable<T, KeyCapacity, Hasher, KeyEqual>;
+
   mutable OAHTStats stats{};
   OAHTConfig config{};
-  std::unique_ptr<OAHTSlot[]> slots{};
+  Hasher hasher;
+  KeyEqual equal{};
+  OAHTArray<OAHTSlot> slots{};
+  OAHTArray<u8> control{};
+  OAHTArray<u64> hashes{};    //!< Full hash of each slot's key
+  OAHTModulo modulo{};        //!< % capacity()
+  OAHTModulo stride_modulo{}; //!< % (capacity() - 1)
+
+  // Slots from before the last grow() that are still being migrated
+  // (MigrationBatch_ only). Its items are counted in size() as well, and
+  // migrated slots are left as tombstones so its probe chains stay intact
+  std::unique_ptr<OAHashTable> draining{};
+  u32 migrated{0}; //!< Slots of draining already migrated
+
+  //! Keys that don't fit in their slot, each followed by a null
+  std::vector<char> keys{};
+  usize compacted{0}; //!< Size of keys after the last compact()
 };
 
 #include "OAHashTable.cpp"
@@ -0,0 +1,539 @@
+#pragma once
+
+#include "RcuOAHashTable.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <utility>
+
+template<typename T>
+RcuOAHashTable<T>::RcuOAHashTable(const OAHTConfig& config):
+    config{config} {
+  const u32 capacity = std::max(config.InitialTableSize_, u32{1});
+
+  current.store(new Array{capacity}, std::memory_order_release);
+
+  stats.TableSize_ = capacity;
+  stats.PrimaryHashFunc_ = config.PrimaryHashFunc_;
+}
+
+template<typename T>
+RcuOAHashTable<T>::~RcuOAHashTable() {
+  // no reader is left, so everything goes at once, without the new array
+  // (and retire lists) clear would allocate
+  Array* array = current.load(std::memory_order_relaxed);
+
+  for (u32 i = 0; i < array->Capacity; i++) {
+    Node* item = array->Slots[i].Item.load(std::memory_order_relaxed);
+
+    if (item != nullptr and item != deleted()) {
+      if (config.FreeProc_) {
+        config.FreeProc_(std::move(item->Data));
+      }
+      free_node(item);
+    }
+  }
+
+  delete array;
+
+  for (const Retired<Node>& retired : retired_nodes) {
+    if (config.FreeProc_) {
+      config.FreeProc_(std::move(retired.Object->Data));
+    }
+    free_node(retired.Object);
+  }
+
+  for (const Retired<Array>& retired : retired_arrays) {
+    delete retired.Object;
+  }
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::reader() -> Reader {
+  std::lock_guard<std::mutex> guard{readers_lock};
+
+  // records of readers that are gone are handed out again
+  for (const auto& record : readers) {
+    bool claimed = false;
+
+    if (record->Claimed.compare_exchange_strong(claimed, true)) {
+      return Reader{this, record.get()};
+    }
+  }
+
+  readers.emplace_back(new ReaderRecord{});
+  return Reader{this, readers.back().get()};
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::insert(const char* key, const T& data) -> void {
+  emplace(key, data);
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::insert(const char* key, T&& data) -> void {
+  emplace(key, std::move(data));
+}
+
+template<typename T>
+template<typename... Args>
+auto RcuOAHashTable<T>::emplace(const char* key, Args&&... args) -> void {
+  if (try_emplace(key, std::forward<Args>(args)...) == S_DUPLICATE) {
+    throw OAHashTableException(
+      OAHashTableException::E_DUPLICATE,
+      "Duplicate key"
+    );
+  }
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::try_insert(const char* key, const T& data)
+  -> OAHTStatus {
+  return try_emplace(key, data);
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::try_insert(const char* key, T&& data) -> OAHTStatus {
+  return try_emplace(key, std::move(data));
+}
+
+template<typename T>
+template<typename... Args>
+auto RcuOAHashTable<T>::try_emplace(const char* key, Args&&... args)
+  -> OAHTStatus {
+  grow_if_needed();
+
+  const u32 hash = this->hash(key);
+  const Array& array = *current.load(std::memory_order_relaxed);
+  u32 index = home(array, hash);
+  Slot* target = nullptr;
+
+  for (u32 i = 0; i < array.Capacity; i++) {
+    Slot& slot = array.Slots[index];
+    const Node* item = slot.Item.load(std::memory_order_relaxed);
+
+    stats.Probes_++;
+
+    if (item == nullptr) {
+      target = target ? target : &slot;
+      break;
+    }
+
+    if (item == deleted()) {
+      target = target ? target : &slot;
+    } else if (item->Hash == hash and std::strcmp(item->key(), key) == 0) {
+      return S_DUPLICATE;
+    }
+
+    index = index + 1 == array.Capacity ? 0 : index + 1;
+  }
+
+  if (not target) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "No free slot on probe sequence"
+    );
+  }
+
+  Node* node = make_node(key, hash, std::forward<Args>(args)...);
+
+  if (target->Item.load(std::memory_order_relaxed) == deleted()) {
+    stats.Tombstones_--;
+  }
+
+  // a reader that sees the node also sees its hash
+  target->Hash.store(hash, std::memory_order_relaxed);
+  target->Item.store(node, std::memory_order_release);
+  stats.Count_++;
+
+  return S_OK;
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::remove(const char* key) -> void {
+  if (try_remove(key) == S_ITEM_NOT_FOUND) {
+    throw OAHashTableException(
+      OAHashTableException::E_ITEM_NOT_FOUND,
+      "Key not in table."
+    );
+  }
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::try_remove(const char* key) -> OAHTStatus {
+  const u32 hash = this->hash(key);
+  const Array& array = *current.load(std::memory_order_relaxed);
+  u32 index = home(array, hash);
+
+  for (u32 i = 0; i < array.Capacity; i++) {
+    Slot& slot = array.Slots[index];
+    Node* item = slot.Item.load(std::memory_order_relaxed);
+
+    stats.Probes_++;
+
+    if (item == nullptr) {
+      return S_ITEM_NOT_FOUND;
+    }
+
+    if (item != deleted() and item->Hash == hash
+        and std::strcmp(item->key(), key) == 0) {
+      slot.Item.store(deleted(), std::memory_order_release);
+      stats.Count_--;
+      stats.Tombstones_++;
+      retire(item);
+      return S_OK;
+    }
+
+    index = index + 1 == array.Capacity ? 0 : index + 1;
+  }
+
+  return S_ITEM_NOT_FOUND;
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::clear() -> void {
+  Array* array = current.load(std::memory_order_relaxed);
+
+  current.store(new Array{array->Capacity}, std::memory_order_release);
+
+  for (u32 i = 0; i < array->Capacity; i++) {
+    Node* item = array->Slots[i].Item.load(std::memory_order_relaxed);
+
+    if (item != nullptr and item != deleted()) {
+      retire(item);
+    }
+  }
+
+  retire(array);
+
+  stats.Count_ = 0;
+  stats.Tombstones_ = 0;
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::reclaim() -> void {
+  // readers from here on start in the new epoch, and cannot reach anything
+  // that was unlinked before it
+  const u64 now = epoch.load(std::memory_order_relaxed);
+  epoch.store(now + 1, std::memory_order_release);
+
+  // pairs with the fence of a starting reader: either it sees the unlinks
+  // made so far, or this scan sees it reading
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  u64 oldest = std::numeric_limits<u64>::max();
+
+  {
+    std::lock_guard<std::mutex> guard{readers_lock};
+
+    for (const auto& record : readers) {
+      const u64 reading = record->Epoch.load(std::memory_order_acquire);
+
+      if (reading != 0) {
+        oldest = std::min(oldest, reading);
+      }
+    }
+  }
+
+  // anything retired before the oldest read started is unreachable
+  auto reachable = [oldest](u64 retired) { return retired >= oldest; };
+
+  auto node = retired_nodes.begin();
+
+  for (; node != retired_nodes.end() and not reachable(node->Epoch); ++node) {
+    if (config.FreeProc_) {
+      config.FreeProc_(std::move(node->Object->Data));
+    }
+    free_node(node->Object);
+  }
+
+  retired_nodes.erase(retired_nodes.begin(), node);
+
+  auto array = retired_arrays.begin();
+
+  for (; array != retired_arrays.end() and not reachable(array->Epoch);
+       ++array) {
+    delete array->Object;
+  }
+
+  retired_arrays.erase(retired_arrays.begin(), array);
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::GetStats() const -> OAHTStats {
+  return stats;
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::size() const -> u32 {
+  return stats.Count_;
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::capacity() const -> u32 {
+  return stats.TableSize_;
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::deleted() -> Node* {
+  // never dereferenced, only compared against
+  static char marker;
+  return reinterpret_cast<Node*>(&marker);
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::hash(const char* key) const -> u32 {
+  // home() only looks at the high bits, which weak hash functions leave 0
+  return OAHTMixHash(config.PrimaryHashFunc_(key, FULL_HASH_RANGE));
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::home(const Array& array, u32 hash) -> u32 {
+  // (hash * capacity) / 2^32, any capacity works
+  return static_cast<u32>((u64{hash} * array.Capacity) >> 32);
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::lookup(const char* key, u32 hash) const
+  -> const Node* {
+  const Array& array = *current.load(std::memory_order_acquire);
+  u32 index = home(array, hash);
+
+  for (u32 i = 0; i < array.Capacity; i++) {
+    const Slot& slot = array.Slots[index];
+    const Node* item = slot.Item.load(std::memory_order_acquire);
+
+    if (item == nullptr) {
+      return nullptr;
+    }
+
+    // a slot reused since item was loaded may show the hash of the new
+    // item, the keys still decide
+    if (item != deleted()
+        and slot.Hash.load(std::memory_order_relaxed) == hash
+        and std::strcmp(item->key(), key) == 0) {
+      return item;
+    }
+
+    index = index + 1 == array.Capacity ? 0 : index + 1;
+  }
+
+  return nullptr;
+}
+
+template<typename T>
+template<typename... Args>
+auto RcuOAHashTable<T>::make_node(
+  const char* key,
+  u32 hash,
+  Args&&... args
+) -> Node* {
+  const usize length = std::strlen(key);
+  void* memory = nullptr;
+
+  try {
+    memory = ::operator new(sizeof(Node) + length + 1);
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
+  }
+
+  Node* node = nullptr;
+
+  try {
+    node = new (memory)
+      Node(hash, static_cast<u32>(length), std::forward<Args>(args)...);
+  } catch (...) {
+    ::operator delete(memory);
+    throw;
+  }
+
+  std::memcpy(reinterpret_cast<char*>(node + 1), key, length + 1);
+  return node;
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::free_node(Node* node) -> void {
+  node->~Node();
+  ::operator delete(node);
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::grow_if_needed() -> void {
+  const u32 capacity = this->capacity();
+  const f64 load_factor{
+    static_cast<f64>(size() + 1) / static_cast<f64>(capacity)
+  };
+
+  if (size() + 1 > capacity or load_factor > config.MaxLoadFactor_) {
+    stats.Expansions_++;
+
+    u32 grown = std::max(
+      static_cast<u32>(std::ceil(config.GrowthFactor_ * capacity)),
+      capacity + 1
+    );
+
+    // straight to the capacity that fits one more item, there is none for
+    // a MaxLoadFactor_ of 0 or less, and then growing once has to do
+    if (config.MaxLoadFactor_ > 0) {
+      const f64 needed{std::ceil((size() + 1) / config.MaxLoadFactor_)};
+      const f64 largest{std::numeric_limits<u32>::max()};
+      grown = std::max(grown, static_cast<u32>(std::min(needed, largest)));
+    }
+
+    rebuild(grown);
+    return;
+  }
+
+  const f64 used{
+    static_cast<f64>(size() + 1 + stats.Tombstones_)
+    / static_cast<f64>(capacity)
+  };
+
+  // a miss only ends at an empty slot, so tombstones must not take the last
+  // of them
+  const bool full = size() + 1 + stats.Tombstones_ >= capacity;
+
+  if (stats.Tombstones_ > 0
+      and (full
+           or (config.PurgeFactor_ > 0 and used > config.PurgeFactor_))) {
+    stats.Purges_++;
+    rebuild(capacity);
+  }
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::rebuild(u32 capacity) -> void {
+  Array* old = current.load(std::memory_order_relaxed);
+  Array* array = nullptr;
+
+  try {
+    array = new Array{capacity};
+  } catch (const std::bad_alloc&) {
+    throw OAHashTableException(
+      OAHashTableException::E_NO_MEMORY,
+      "std::bad_alloc thrown: no memory"
+    );
+  }
+
+  // nobody sees the new array yet, the nodes are shared with the old one
+  for (u32 i = 0; i < old->Capacity; i++) {
+    const Slot& from = old->Slots[i];
+    Node* item = from.Item.load(std::memory_order_relaxed);
+
+    if (item == nullptr or item == deleted()) {
+      continue;
+    }
+
+    u32 index = home(*array, item->Hash);
+
+    while (array->Slots[index].Item.load(std::memory_order_relaxed)) {
+      index = index + 1 == capacity ? 0 : index + 1;
+    }
+
+    array->Slots[index].Hash.store(item->Hash, std::memory_order_relaxed);
+    array->Slots[index].Item.store(item, std::memory_order_relaxed);
+  }
+
+  // readers that load the array see it filled in
+  current.store(array, std::memory_order_release);
+
+  stats.TableSize_ = capacity;
+  stats.Tombstones_ = 0;
+
+  retire(old);
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::retire(Node* node) -> void {
+  retired_nodes.push_back({epoch.load(std::memory_order_relaxed), node});
+
+  if (retired_nodes.size() >= RCU_RECLAIM_BATCH) {
+    reclaim();
+  }
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::retire(Array* array) -> void {
+  retired_arrays.push_back({epoch.load(std::memory_order_relaxed), array});
+
+  if (retired_arrays.size() >= RCU_RECLAIM_BATCH) {
+    reclaim();
+  }
+}
+
+template<typename T>
+RcuOAHashTable<T>::Reader::Reader(
+  const RcuOAHashTable* table,
+  ReaderRecord* record
+):
+    table{table},
+    record{record} {}
+
+template<typename T>
+RcuOAHashTable<T>::Reader::Reader(Reader&& from):
+    table{from.table},
+    record{std::exchange(from.record, nullptr)} {}
+
+template<typename T>
+RcuOAHashTable<T>::Reader::~Reader() {
+  if (record) {
+    record->Claimed.store(false, std::memory_order_release);
+  }
+}
+
+template<typename T>
+RcuOAHashTable<T>::Reader::Read::Read(
+  const RcuOAHashTable* table,
+  ReaderRecord* record
+):
+    record{record} {
+  record->Epoch.store(
+    table->epoch.load(std::memory_order_acquire),
+    std::memory_order_relaxed
+  );
+
+  // pairs with the fence in reclaim(): either the writer sees this read, or
+  // this read sees everything the writer unlinked before looking
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+template<typename T>
+RcuOAHashTable<T>::Reader::Read::~Read() {
+  record->Epoch.store(0, std::memory_order_release);
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::Reader::find(const char* key) const -> T {
+  const u32 hash = table->hash(key);
+  const Read read{table, record};
+  const Node* node = table->lookup(key, hash);
+
+  if (node) {
+    return node->Data;
+  }
+
+  throw OAHashTableException(
+    OAHashTableException::E_ITEM_NOT_FOUND,
+    "Item not found in table."
+  );
+}
+
+template<typename T>
+auto RcuOAHashTable<T>::Reader::try_find(const char* key, T& data) const
+  -> OAHTStatus {
+  const u32 hash = table->hash(key);
+  const Read read{table, record};
+  const Node* node = table->lookup(key, hash);
+
+  if (not node) {
+    return S_ITEM_NOT_FOUND;
+  }
+
+  data = node->Data;
+  return S_OK;
+}
@@ -0,0 +1,233 @@
+//---------------------------------------------------------------------------
+#ifndef RCUOAHASHTABLEH
+#define RCUOAHASHTABLEH
+//---------------------------------------------------------------------------
+
+#include "OAHashTable.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief How many removed items (or replaced slot arrays) an RcuOAHashTable
+ * collects before it tries to free them
+ */
+const usize RCU_RECLAIM_BATCH = 64;
+
+//! Open addressing table for one writer thread and any number of reader
+//! threads (read-copy-update). Readers take no lock and write nothing that is
+//! shared: they find items through a RcuOAHashTable::Reader, which only
+//! writes its own cache line to say which epoch it is reading in.
+//!
+//! Items live in immutable nodes that the slots point to, so a reader always
+//! sees a whole key/data pair. The writer never changes a node in place, it
+//! unlinks it. grow() builds a new slot array off to the side and publishes
+//! it with a single store. Unlinked nodes (their data goes to FreeProc_) and
+//! old slot arrays are freed once every reader that could still see them
+//! has finished.
+//!
+//! Only InitialTableSize_, PrimaryHashFunc_, MaxLoadFactor_, GrowthFactor_,
+//! PurgeFactor_ and FreeProc_ of the config are used: probing is linear and
+//! deletion marks the slot, since moving items around would hide them from
+//! readers
+template<typename T>
+class RcuOAHashTable {
+public:
+
+  using OAHTConfig = typename OAHashTable<T>::OAHTConfig;
+
+  explicit RcuOAHashTable(const OAHTConfig& config);
+
+  // Frees everything, no Reader may still be reading
+  ~RcuOAHashTable();
+
+  RcuOAHashTable(const RcuOAHashTable&) = delete;
+  auto operator=(const RcuOAHashTable&) -> RcuOAHashTable& = delete;
+
+  class Reader;
+
+  // A reader for the calling thread, may be called from any thread. Each
+  // reading thread needs one of its own
+  auto reader() -> Reader;
+
+  // The writer side, only ever called from one thread at a time. They work
+  // like their OAHashTable counterparts
+  auto insert(const char* key, const T& data) -> void;
+
+  auto insert(const char* key, T&& data) -> void;
+
+  template<typename... Args>
+  auto emplace(const char* key, Args&&... args) -> void;
+
+  auto try_insert(const char* key, const T& data) -> OAHTStatus;
+
+  auto try_insert(const char* key, T&& data) -> OAHTStatus;
+
+  template<typename... Args>
+  auto try_emplace(const char* key, Args&&... args) -> OAHTStatus;
+
+  auto remove(const char* key) -> void;
+
+  auto try_remove(const char* key) -> OAHTStatus;
+
+  auto clear() -> void;
+
+  // Frees whatever no reader can see anymore without waiting for a full
+  // batch
+  auto reclaim() -> void;
+
+  // Probes_ only counts the probes of the writer, readers don't count
+  auto GetStats() const -> OAHTStats;
+
+  auto size() const -> u32;
+
+  auto capacity() const -> u32;
+
+private:
+
+  struct Node {
+    template<typename... Args>
+    Node(u32 hash, u32 length, Args&&... args):
+        Data(std::forward<Args>(args)...),
+        Hash{hash},
+        Length{length} {}
+
+    // the key is allocated right behind the node
+    auto key() const -> const char* {
+      return reinterpret_cast<const char*>(this + 1);
+    }
+
+    T Data;
+    u32 Hash;
+    u32 Length;
+  };
+
+  struct Slot {
+    std::atomic<u32> Hash{0}; // copy of Item->Hash, saves loading the node
+    std::atomic<Node*> Item{nullptr};
+  };
+
+  struct Array {
+    explicit Array(u32 capacity):
+        Capacity{capacity},
+        Slots{new Slot[capacity]{}} {}
+
+    u32 Capacity;
+    std::unique_ptr<Slot[]> Slots;
+  };
+
+  // What a reader announces, each on a cache line of its own. Before C++17
+  // new ignores alignas, so a record is placed on the first cache line
+  // boundary of a larger block, with the block's address just before it
+  struct alignas(64) ReaderRecord {
+    static auto operator new(usize bytes) -> void* {
+      char* block = static_cast<char*>(::operator new(bytes + 64));
+      char* record = block + 64 - reinterpret_cast<std::uintptr_t>(block) % 64;
+      reinterpret_cast<char**>(record)[-1] = block;
+      return record;
+    }
+
+    static auto operator delete(void* memory) -> void {
+      ::operator delete(static_cast<char**>(memory)[-1]);
+    }
+
+    std::atomic<u64> Epoch{0}; // 0 while not reading
+    char Padding[64 - sizeof(std::atomic<u64>)];
+    std::atomic<bool> Claimed{true};
+  };
+
+  template<typename Item>
+  struct Retired {
+    u64 Epoch;
+    Item* Object;
+  };
+
+  // Marks the slot of a removed item
+  static auto deleted() -> Node*;
+
+  auto hash(const char* key) const -> u32;
+
+  // First slot probed for hash in array
+  static auto home(const Array& array, u32 hash) -> u32;
+
+  // The node of key, or nullptr. Safe for readers inside a read
+  auto lookup(const char* key, u32 hash) const -> const Node*;
+
+  template<typename... Args>
+  auto make_node(const char* key, u32 hash, Args&&... args) -> Node*;
+
+  static auto free_node(Node* node) -> void;
+
+  // Grows the table (or purges its tombstones) before an insert would go
+  // past MaxLoadFactor_
+  auto grow_if_needed() -> void;
+
+  // Copies every live node pointer into a new array of the given capacity
+  // and publishes it
+  auto rebuild(u32 capacity) -> void;
+
+  // The node can be freed once no reader may still hold it
+  auto retire(Node* node) -> void;
+
+  auto retire(Array* array) -> void;
+
+  OAHTConfig config;
+  OAHTStats stats{};
+
+  std::atomic<Array*> current{nullptr};
+
+  // Bumped by reclaim(), readers record it when they start reading
+  std::atomic<u64> epoch{1};
+
+  std::vector<Retired<Node>> retired_nodes{};
+  std::vector<Retired<Array>> retired_arrays{};
+
+  std::mutex readers_lock{}; // only taken to register and scan readers
+  std::vector<std::unique_ptr<ReaderRecord>> readers{};
+};
+
+//! A reading thread's handle on an RcuOAHashTable. find copies the data out,
+//! since the node may be freed once the read is over
+template<typename T>
+class RcuOAHashTable<T>::Reader {
+public:
+
+  Reader(Reader&& from);
+
+  ~Reader();
+
+  Reader(const Reader&) = delete;
+  auto operator=(const Reader&) -> Reader& = delete;
+  auto operator=(Reader&&) -> Reader& = delete;
+
+  // A copy of the data of key. Throws an exception (E_ITEM_NOT_FOUND) if
+  // not found
+  auto find(const char* key) const -> T;
+
+  // Copies the data of key into data, or returns S_ITEM_NOT_FOUND and
+  // leaves it alone
+  auto try_find(const char* key, T& data) const -> OAHTStatus;
+
+private:
+
+  friend class RcuOAHashTable;
+
+  // Announces a read in the record for as long as it lives
+  struct Read {
+    Read(const RcuOAHashTable* table, ReaderRecord* record);
+
+    ~Read();
+
+    ReaderRecord* record;
+  };
+
+  Reader(const RcuOAHashTable* table, ReaderRecord* record);
+
+  const RcuOAHashTable* table;
+  ReaderRecord* record;
+};
+
+#include "RcuOAHashTable.cpp"
+
+#endif
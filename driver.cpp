@@ -1,11 +1,23 @@
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <cctype>
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
 using namespace std;
 
+#include "ConcurrentOAHashTable.h"
+#include "CuckooHashTable.h"
+#include "FastHash.h"
+#include "HugePages.h"
+#include "LockFreeOAHashTable.h"
 #include "OAHashTable.h"
+#include "RcuOAHashTable.h"
 
 const unsigned ID_LEN = 6;
 
@@ -230,7 +242,8 @@ enum HASHFUNCS {
   SIMPLE,
   RS,
   UNIVERSAL,
-  PJW
+  PJW,
+  FAST
 };
 
 HashData HashingFuncs[] = {
@@ -240,7 +253,8 @@ HashData HashingFuncs[] = {
   {SimpleHash,    "Simple Hash"          },
   {RSHash,        "RS Hash"              },
   {UHash,         "Universal Hash"       },
-  {PJWHash,       "PJW Hash"             }
+  {PJWHash,       "PJW Hash"             },
+  {FastHash,      "FastHash"             }
 };
 
 void Dispose(Person*) {}
@@ -972,6 +986,1686 @@ void TestSimpleMarkPack(
   }
 }
 
+const char* StatusName(OAHTStatus status) {
+  switch (status) {
+    case S_OK: return "S_OK";
+    case S_ITEM_NOT_FOUND: return "S_ITEM_NOT_FOUND";
+    case S_DUPLICATE: return "S_DUPLICATE";
+  }
+  return "Unknown status";
+}
+
+const unsigned NUM_PEOPLE = sizeof(PEOPLE) / sizeof(*PEOPLE);
+
+// Keys like the ones of TestSimpleGrow1, as strings
+vector<string> MakeIDs(unsigned count) {
+  vector<string> ids;
+  char ID[16];
+
+  for (unsigned i = 0; i < count; i++) {
+    sprintf(ID, "%07d", i);
+    RevString(ID);
+    ids.push_back(ID);
+  }
+  return ids;
+}
+
+unsigned FreedCount = 0;
+
+void CountFree(unsigned) { FreedCount++; }
+
+// insert/delete (BACKSHIFT), no tombstones are left behind
+void TestBackshift() {
+  cout << endl
+       << "==================== TestBackshift ====================" << endl;
+
+  typedef Person* T;
+  OAHashTable<T> ht(
+    OAHashTable<T>::OAHTConfig(11, PJWHash, NULL, 1.0, 2.0, BACKSHIFT, 0)
+  );
+  try {
+    for (unsigned i = 0; i < 11; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+    cout << endl;
+
+    ht.remove("106001");
+    ht.remove("101001");
+    ht.remove("109001");
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+    cout << "Tombstones: " << ht.GetStats().Tombstones_ << endl;
+
+    for (unsigned i = 0; i < 11; i++) {
+      const char* key = PersonRecs[i]->ID;
+      cout << key << ": " << (ht.try_find(key) ? "found" : "not found")
+           << endl;
+    }
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestBackshift" << endl
+         << endl;
+  }
+}
+
+// Robin Hood insertion, lookups and removal with MARK
+void TestRobinHood() {
+  cout << endl
+       << "==================== TestRobinHood ====================" << endl;
+
+  typedef Person* T;
+  OAHashTable<T>::OAHTConfig config(17, SimpleHash, NULL, 0.95, 2.0, MARK, 0);
+  config.RobinHood_ = true;
+  OAHashTable<T> ht(config);
+  try {
+    for (unsigned i = 0; i < 15; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+    cout << endl;
+
+    cout << "try_insert 103001: "
+         << StatusName(ht.try_insert("103001", PersonRecs[0])) << endl;
+    cout << *ht.find("103001") << endl;
+
+    ht.remove("102001");
+    ht.remove("110001");
+    cout << "try_remove 110001: " << StatusName(ht.try_remove("110001"))
+         << endl;
+
+    ht.insert("122001", PersonRecs[21]);
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+
+    for (unsigned i = 0; i < 15; i++) {
+      const char* key = PersonRecs[i]->ID;
+      cout << key << ": " << (ht.try_find(key) ? "found" : "not found")
+           << endl;
+    }
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestRobinHood" << endl
+         << endl;
+  }
+}
+
+// Tombstones left by MARK are purged without growing the table
+void TestPurge() {
+  cout << endl
+       << "==================== TestPurge ====================" << endl;
+
+  typedef Person* T;
+  OAHashTable<T>::OAHTConfig config(17, SimpleHash, NULL, 0.95, 2.0, MARK, 0);
+  config.PurgeFactor_ = 0.8;
+  OAHashTable<T> ht(config);
+  try {
+    for (unsigned round = 0; round < 3; round++) {
+      for (unsigned i = 0; i < 12; i++) {
+        Person* person = PersonRecs[(round * 4 + i) % NUM_PEOPLE];
+        ht.try_insert(person->ID, person);
+      }
+      for (unsigned i = 0; i < 8; i++) {
+        ht.try_remove(PersonRecs[(round * 4 + i) % NUM_PEOPLE]->ID);
+      }
+
+      cout << "Round " << round << ": " << ht.GetStats().Count_
+           << " items, " << ht.GetStats().Tombstones_ << " tombstones, "
+           << ht.GetStats().Purges_ << " purges, "
+           << ht.GetStats().Expansions_ << " expansions" << endl;
+    }
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl << "**** Something bad happened in TestPurge" << endl << endl;
+  }
+}
+
+// Incremental growth: lookups and removals see both slot arrays while the
+// items migrate
+void TestMigration() {
+  cout << endl
+       << "==================== TestMigration ====================" << endl;
+
+  typedef Person* T;
+  OAHashTable<T>::OAHTConfig config(5, SimpleHash, NULL, 0.75, 2.0, PACK, 0);
+  config.MigrationBatch_ = 2;
+  OAHashTable<T> ht(config);
+  try {
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+
+      unsigned found = 0;
+      for (unsigned j = 0; j <= i; j++) {
+        found += ht.try_find(PersonRecs[j]->ID) != nullptr;
+      }
+      cout << "Inserted " << i + 1 << ", found " << found
+           << ", TableSize: " << ht.GetStats().TableSize_ << endl;
+    }
+
+    for (unsigned i = 0; i < NUM_PEOPLE; i += 2) {
+      ht.remove(PersonRecs[i]->ID);
+    }
+    cout << "try_remove 101001: " << StatusName(ht.try_remove("101001"))
+         << endl;
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestMigration" << endl
+         << endl;
+  }
+}
+
+// reserve() grows once up front, rehash() and clear() keep the items right
+void TestReserveRehash() {
+  cout << endl
+       << "==================== TestReserveRehash ===================="
+       << endl;
+
+  typedef Person* T;
+  OAHashTable<T> ht(
+    OAHashTable<T>::OAHTConfig(5, UHash, RSHash, 0.75, 2.0, MARK, 0)
+  );
+  try {
+    ht.reserve(NUM_PEOPLE);
+    DumpStats<T>(ht);
+
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+    DumpStats<T>(ht);
+
+    ht.remove("104001");
+    ht.remove("117001");
+    ht.rehash(0);
+    cout << "Tombstones after rehash: " << ht.GetStats().Tombstones_ << endl;
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+
+    ht.rehash(100);
+    DumpStats<T>(ht);
+    cout << *ht.find("123001") << endl;
+
+    ht.clear();
+    DumpStats<T>(ht);
+
+    // the smallest table still has room for a double hashing stride
+    ht.rehash(0);
+    DumpStats<T>(ht);
+    cout << "try_find 101001: "
+         << (ht.try_find("101001") ? "found" : "nullptr") << endl;
+    ht.insert("101001", PersonRecs[0]);
+    cout << *ht.find("101001") << endl;
+    DumpStats<T>(ht);
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestReserveRehash" << endl
+         << endl;
+  }
+}
+
+// The try_ operations return a status where the others throw
+void TestTryOperations() {
+  cout << endl
+       << "==================== TestTryOperations ===================="
+       << endl;
+
+  typedef Person* T;
+  OAHashTable<T> ht(
+    OAHashTable<T>::OAHTConfig(11, PJWHash, NULL, 0.75, 2.0, PACK, 0)
+  );
+  try {
+    const char* keys[] = {"101001", "102001", "103001", "104001"};
+    const T values[] = {PersonRecs[0], PersonRecs[1], PersonRecs[2],
+                        PersonRecs[3]};
+    ht.insert_range(keys, values, 4);
+
+    cout << "try_insert 105001: "
+         << StatusName(ht.try_insert("105001", PersonRecs[4])) << endl;
+    cout << "try_insert 101001: "
+         << StatusName(ht.try_insert("101001", PersonRecs[4])) << endl;
+    cout << "try_emplace 106001: "
+         << StatusName(ht.try_emplace("106001", PersonRecs[5])) << endl;
+    cout << "try_emplace 106001: "
+         << StatusName(ht.try_emplace("106001", PersonRecs[5])) << endl;
+    cout << "try_remove 102001: " << StatusName(ht.try_remove("102001"))
+         << endl;
+    cout << "try_remove 102001: " << StatusName(ht.try_remove("102001"))
+         << endl;
+    cout << "try_find 102001: "
+         << (ht.try_find("102001") ? "found" : "nullptr") << endl;
+    cout << "try_find 101001: " << **ht.try_find("101001") << endl;
+
+    try {
+      ht.insert("103001", PersonRecs[2]);
+    } catch (OAHashTableException& e) {
+      cout << "insert 103001: errno: " << e.code() << ", " << e.what() << endl;
+    }
+
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestTryOperations" << endl
+         << endl;
+  }
+}
+
+// find_many on tables with control bytes, stored hashes, a power of two
+// capacity and a digest function
+void TestFindMany() {
+  cout << endl
+       << "==================== TestFindMany ====================" << endl;
+
+  typedef Person* T;
+  const char* keys[] = {"101001", "999999", "123001", "110001",
+                        "000000", "115001", "122001"};
+  const unsigned count = sizeof(keys) / sizeof(*keys);
+
+  for (unsigned option = 0; option < 4; option++) {
+    OAHashTable<T>::OAHTConfig config(7, UHash, RSHash, 0.75, 2.0, MARK, 0);
+    config.ControlBytes_ = option == 1;
+    config.StoreHashes_ = option == 2;
+    config.CapacityPolicy_ = option == 2 ? POWER_OF_TWO : PRIME;
+    config.DigestFunc_ = option == 3 ? FastDigest : NULL;
+
+    const char* names[] = {"Plain", "ControlBytes_",
+                           "StoreHashes_, POWER_OF_TWO", "DigestFunc_"};
+    cout << endl << names[option] << ":" << endl;
+
+    try {
+      OAHashTable<T> ht(config);
+      for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+        Person* person = PersonRecs[i];
+        ht.insert(person->ID, person);
+      }
+      ht.remove("110001");
+
+      const T* out[count];
+      cout << "Found " << ht.find_many(keys, count, out) << " of " << count
+           << endl;
+      for (unsigned i = 0; i < count; i++) {
+        cout << keys[i] << ": " << (out[i] ? (*out[i])->lastName : "nullptr")
+             << endl;
+      }
+      cout << "Items: " << ht.GetStats().Count_
+           << ", TableSize: " << ht.GetStats().TableSize_ << endl;
+    } catch (OAHashTableException& e) {
+      cout << endl
+           << "errno: " << e.code() << ", " << e.what() << endl
+           << endl;
+    } catch (...) {
+      cout << endl
+           << "**** Something bad happened in TestFindMany" << endl
+           << endl;
+    }
+  }
+}
+
+// Sharded table, written to from several threads at once
+void TestConcurrent() {
+  cout << endl
+       << "==================== TestConcurrent ====================" << endl;
+
+  typedef unsigned T;
+  const unsigned threads = 4;
+  const unsigned count = 4000;
+  const vector<string> ids = MakeIDs(count);
+
+  try {
+    ConcurrentOAHashTable<T> ht(
+      OAHashTable<T>::OAHTConfig(64, FastHash, NULL, 0.75, 2.0, PACK, 0),
+      8
+    );
+
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+      workers.emplace_back([&, t] {
+        for (unsigned i = t; i < count; i += threads) {
+          ht.insert(ids[i].c_str(), i);
+        }
+      });
+    }
+    for (thread& worker : workers) {
+      worker.join();
+    }
+
+    cout << "Shards: " << ht.shards() << ", items: " << ht.size() << endl;
+    cout << "try_insert " << ids[7] << ": "
+         << StatusName(ht.try_insert(ids[7].c_str(), 0)) << endl;
+
+    for (unsigned i = 0; i < count; i += 2) {
+      ht.remove(ids[i].c_str());
+    }
+
+    unsigned right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      T value = 0;
+      right += ht.try_find(ids[i].c_str(), value) == S_OK and value == i;
+    }
+    cout << "After removing half: " << ht.size() << " items, " << right
+         << " found" << endl;
+    cout << "find " << ids[7] << ": " << ht.find(ids[7].c_str()) << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestConcurrent" << endl
+         << endl;
+  }
+}
+
+// One writer, readers on other threads
+void TestRcu() {
+  cout << endl << "==================== TestRcu ====================" << endl;
+
+  typedef unsigned T;
+  const unsigned count = 2000;
+  const vector<string> ids = MakeIDs(count);
+  FreedCount = 0;
+
+  try {
+    RcuOAHashTable<T> ht(OAHashTable<T>::OAHTConfig(
+      8, FastHash, NULL, 0.75, 2.0, MARK, CountFree
+    ));
+
+    for (unsigned i = 0; i < count / 2; i++) {
+      ht.insert(ids[i].c_str(), i);
+    }
+
+    // the first half stays put while the writer adds the second half
+    unsigned right = 0;
+    thread reader([&] {
+      typename RcuOAHashTable<T>::Reader read = ht.reader();
+
+      for (unsigned pass = 0; pass < 4; pass++) {
+        for (unsigned i = 0; i < count / 2; i++) {
+          T value = 0;
+          right += read.try_find(ids[i].c_str(), value) == S_OK and value == i;
+        }
+      }
+    });
+    for (unsigned i = count / 2; i < count; i++) {
+      ht.insert(ids[i].c_str(), i);
+    }
+    reader.join();
+    cout << "Reader found " << right << " of " << 2 * count << endl;
+
+    for (unsigned i = 0; i < count; i += 2) {
+      ht.remove(ids[i].c_str());
+    }
+    ht.reclaim();
+    cout << "Items: " << ht.size() << ", freed: " << FreedCount << endl;
+
+    typename RcuOAHashTable<T>::Reader read = ht.reader();
+    T value = 0;
+    cout << "try_find " << ids[0] << ": "
+         << StatusName(read.try_find(ids[0].c_str(), value)) << endl;
+    cout << "find " << ids[1] << ": " << read.find(ids[1].c_str()) << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl << "**** Something bad happened in TestRcu" << endl << endl;
+  }
+  cout << "Freed after destruction: " << FreedCount << endl;
+
+  // no capacity meets a load factor of 0, and a growth factor of 1 adds
+  // nothing, the table still grows a slot at a time
+  try {
+    RcuOAHashTable<T> ht(OAHashTable<T>::OAHTConfig(
+      1, FastHash, NULL, 0.0, 1.0, MARK, 0
+    ));
+
+    for (unsigned i = 0; i < 10; i++) {
+      ht.insert(ids[i].c_str(), i);
+    }
+    cout << "MaxLoadFactor_ 0: " << ht.size() << " items, "
+         << ht.GetStats().Expansions_ << " expansions" << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl << "**** Something bad happened in TestRcu" << endl << endl;
+  }
+}
+
+// A client hash function that leaves the high bits 0 still spreads the keys
+void TestRcuHashFunc(HashData* phd) {
+  cout << endl
+       << "==================== TestRcuHashFunc ====================" << endl;
+
+  cout << "Primary hash function: " << phd->Name << endl;
+
+  typedef unsigned T;
+  const unsigned count = 20000;
+  const vector<string> ids = MakeIDs(count);
+
+  try {
+    RcuOAHashTable<T> ht(
+      OAHashTable<T>::OAHTConfig(8, phd->Fn, NULL, 0.75, 2.0, MARK, 0)
+    );
+
+    for (unsigned i = 0; i < count; i++) {
+      ht.insert(ids[i].c_str(), i);
+    }
+    cout << "Probes per insert: " << ht.GetStats().Probes_ / count << endl;
+
+    typename RcuOAHashTable<T>::Reader read = ht.reader();
+    unsigned right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      T value = 0;
+      right += read.try_find(ids[i].c_str(), value) == S_OK and value == i;
+    }
+    cout << "Items: " << ht.size() << ", found " << right << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestRcuHashFunc" << endl
+         << endl;
+  }
+}
+
+// Several threads insert the same keys without locks, one of them wins
+void TestLockFree(HashData* phd) {
+  cout << endl
+       << "==================== TestLockFree ====================" << endl;
+
+  cout << "Primary hash function: " << phd->Name << endl;
+
+  typedef unsigned T;
+  const unsigned threads = 4;
+  const unsigned count = 20000;
+  const vector<string> ids = MakeIDs(count);
+  FreedCount = 0;
+  // data of inserts that lost a race with the same key also goes through
+  // FreeProc_, only the items of the table count below
+  unsigned discarded = 0;
+
+  try {
+    LockFreeOAHashTable<T> ht(OAHashTable<T>::OAHTConfig(
+      8, phd->Fn, NULL, 0.75, 2.0, PACK, CountFree
+    ));
+
+    vector<unsigned> inserted(threads);
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+      workers.emplace_back([&, t] {
+        for (unsigned i = 0; i < count; i++) {
+          inserted[t] += ht.try_insert(ids[i].c_str(), i) == S_OK;
+        }
+      });
+    }
+    for (thread& worker : workers) {
+      worker.join();
+    }
+    discarded = FreedCount;
+
+    unsigned total = 0;
+    for (unsigned t = 0; t < threads; t++) {
+      total += inserted[t];
+    }
+
+    unsigned right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = ht.try_find(ids[i].c_str());
+      right += value and *value == i;
+    }
+    cout << "Inserted " << total << ", items: " << ht.size() << ", found "
+         << right << endl;
+    cout << "try_find 9999999: "
+         << (ht.try_find("9999999") ? "found" : "nullptr") << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestLockFree" << endl
+         << endl;
+  }
+  cout << "Freed after destruction: " << FreedCount - discarded << endl;
+
+  // no capacity meets a load factor of 0, and a growth factor of 1 adds
+  // nothing, the table still grows a slot at a time
+  try {
+    LockFreeOAHashTable<T> ht(OAHashTable<T>::OAHTConfig(
+      1, phd->Fn, NULL, 0.0, 1.0, PACK, 0
+    ));
+
+    for (unsigned i = 0; i < 10; i++) {
+      ht.insert(ids[i].c_str(), i);
+    }
+    cout << "MaxLoadFactor_ 0: " << ht.size() << " items" << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestLockFree" << endl
+         << endl;
+  }
+}
+
+void CountFreePointer(unique_ptr<unsigned>) { FreedCount++; }
+
+// Threads inserting the same keys at once: data the table moved from but did
+// not keep is handed to FreeProc_, any other stays with the caller
+void TestLockFreeDuplicates() {
+  cout << endl
+       << "==================== TestLockFreeDuplicates ===================="
+       << endl;
+
+  typedef unique_ptr<unsigned> T;
+  const unsigned threads = 4;
+  const unsigned count = 20000;
+  const vector<string> ids = MakeIDs(count);
+  FreedCount = 0;
+  unsigned discarded = 0;
+
+  try {
+    LockFreeOAHashTable<T> ht(OAHashTable<T>::OAHTConfig(
+      8, FastHash, NULL, 0.75, 2.0, PACK, CountFreePointer
+    ));
+
+    vector<unsigned> inserted(threads);
+    vector<unsigned> duplicates(threads);
+    vector<unsigned> taken(threads);
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+      workers.emplace_back([&, t] {
+        for (unsigned i = 0; i < count; i++) {
+          T value(new unsigned(i));
+
+          if (ht.try_insert(ids[i].c_str(), std::move(value)) == S_OK) {
+            inserted[t]++;
+          } else {
+            duplicates[t]++;
+            taken[t] += value == nullptr;
+          }
+        }
+      });
+    }
+    for (thread& worker : workers) {
+      worker.join();
+    }
+    discarded = FreedCount;
+
+    unsigned total = 0;
+    unsigned total_duplicates = 0;
+    unsigned total_taken = 0;
+    for (unsigned t = 0; t < threads; t++) {
+      total += inserted[t];
+      total_duplicates += duplicates[t];
+      total_taken += taken[t];
+    }
+
+    unsigned right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = ht.try_find(ids[i].c_str());
+      right += value and **value == i;
+    }
+    cout << "Inserted " << total << ", duplicates: " << total_duplicates
+         << ", items: " << ht.size() << ", found " << right << endl;
+    cout << "Every duplicate moved from went to FreeProc_: "
+         << (total_taken == discarded ? "yes" : "no") << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestLockFreeDuplicates" << endl
+         << endl;
+  }
+  cout << "Freed after destruction: " << FreedCount - discarded << endl;
+}
+
+// Growing big tables on several threads
+void TestGrowThreads() {
+  cout << endl
+       << "==================== TestGrowThreads ===================="
+       << endl;
+
+  typedef unsigned T;
+  const unsigned count = 70000;
+  const vector<string> ids = MakeIDs(count);
+
+  OAHashTable<T>::OAHTConfig config(5, FastHash, NULL, 0.5, 2.0, MARK, 0);
+  config.GrowThreads_ = 4;
+
+  try {
+    OAHashTable<T> grown(config);
+    for (unsigned i = 0; i < count; i++) {
+      grown.insert(ids[i].c_str(), i);
+    }
+
+    unsigned right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = grown.try_find(ids[i].c_str());
+      right += value and *value == i;
+    }
+    cout << "grown: " << grown.GetStats().Count_ << " items, " << right
+         << " found, " << grown.GetStats().Expansions_ << " expansions"
+         << endl;
+
+    grown.rehash(4 * grown.GetStats().TableSize_);
+    right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = grown.try_find(ids[i].c_str());
+      right += value and *value == i;
+    }
+    cout << "rehashed: " << grown.GetStats().TableSize_ << " slots, " << right
+         << " found" << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestGrowThreads" << endl
+         << endl;
+  }
+}
+
+// Building big tables on several threads
+void TestBuildParallel() {
+  cout << endl
+       << "==================== TestBuildParallel ===================="
+       << endl;
+
+  typedef unsigned T;
+  const unsigned count = 70000;
+  const vector<string> ids = MakeIDs(count);
+  vector<const char*> keys;
+  vector<T> values;
+  for (unsigned i = 0; i < count; i++) {
+    keys.push_back(ids[i].c_str());
+    values.push_back(i);
+  }
+
+  OAHashTable<T>::OAHTConfig config(5, FastHash, NULL, 0.5, 2.0, MARK, 0);
+
+  try {
+    OAHashTable<T> built{
+      OAHashTable<T>::build_parallel(keys.data(), values.data(), count,
+                                     config, 4)
+    };
+
+    unsigned right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = built.try_find(keys[i]);
+      right += value and *value == i;
+    }
+    cout << "build_parallel: " << built.GetStats().Count_ << " items, "
+         << right << " found" << endl;
+
+    // the table thrown away still frees every item it took
+    keys[count - 1] = keys[0];
+    config.FreeProc_ = CountFree;
+    FreedCount = 0;
+    OAHashTable<T>::build_parallel(keys.data(), values.data(), count, config,
+                                   4);
+  } catch (OAHashTableException& e) {
+    cout << "Repeated key: errno: " << e.code() << ", " << e.what() << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestBuildParallel" << endl
+         << endl;
+  }
+  cout << "Freed: " << FreedCount << endl;
+}
+
+// Cuckoo hashing, also with hash functions that put every key together
+void TestCuckoo(HashData* phd, HashData* shd) {
+  cout << endl
+       << "==================== TestCuckoo ====================" << endl;
+
+  cout << "Primary hash function: " << phd->Name << endl;
+  cout << "Secondary hash function: " << shd->Name << endl;
+
+  typedef Person* T;
+  try {
+    CuckooHashTable<T> ht(
+      OAHashTable<T>::OAHTConfig(8, phd->Fn, shd->Fn, 0.75, 2.0, PACK, 0)
+    );
+
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+    cout << "try_insert 101001: "
+         << StatusName(ht.try_insert("101001", PersonRecs[0])) << endl;
+
+    ht.remove("106001");
+    ht.remove("115001");
+    cout << "try_remove 115001: " << StatusName(ht.try_remove("115001"))
+         << endl;
+
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      const char* key = PersonRecs[i]->ID;
+      cout << key << ": " << (ht.try_find(key) ? "found" : "not found")
+           << endl;
+    }
+    cout << *ht.find("123001") << endl;
+    cout << "Items: " << ht.GetStats().Count_
+         << ", TableSize: " << ht.GetStats().TableSize_ << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestCuckoo" << endl
+         << endl;
+  }
+
+  // no capacity meets a load factor of 0, and a growth factor of 1 adds
+  // nothing, the table still grows a bucket at a time
+  try {
+    CuckooHashTable<T> ht(
+      OAHashTable<T>::OAHTConfig(1, phd->Fn, shd->Fn, 0.0, 1.0, PACK, 0)
+    );
+
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+    cout << "MaxLoadFactor_ 0: " << ht.size() << " items" << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestCuckoo" << endl
+         << endl;
+  }
+}
+
+// A cuckoo table filled by a client hash function that leaves the high bits
+// 0, or puts every key together, still reaches its load factor before it
+// grows
+void TestCuckooLoad(HashData* phd) {
+  cout << endl
+       << "==================== TestCuckooLoad ====================" << endl;
+
+  cout << "Primary hash function: " << phd->Name << endl;
+
+  typedef unsigned T;
+  const unsigned count = 20000;
+  const vector<string> ids = MakeIDs(count);
+
+  try {
+    CuckooHashTable<T> ht(
+      OAHashTable<T>::OAHTConfig(8, phd->Fn, NULL, 0.75, 2.0, PACK, 0)
+    );
+
+    for (unsigned i = 0; i < count; i++) {
+      ht.insert(ids[i].c_str(), i);
+    }
+
+    // a lookup reads two buckets and the stash, whatever the hashes
+    unsigned right = 0;
+    unsigned most = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const unsigned probes = ht.GetStats().Probes_;
+      const T* value = ht.try_find(ids[i].c_str());
+      right += value and *value == i;
+      most = max(most, ht.GetStats().Probes_ - probes);
+    }
+    cout << "Items: " << ht.size() << ", found " << right
+         << ", most probes per lookup: " << most << endl;
+    cout << "TableSize: " << ht.GetStats().TableSize_
+         << ", expansions: " << ht.GetStats().Expansions_ << endl;
+    cout << "Load factor: " << setprecision(3)
+         << static_cast<double>(ht.size()) / ht.GetStats().TableSize_ << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestCuckooLoad" << endl
+         << endl;
+  }
+}
+
+// Keys of 32 characters and more, with room for 7 characters in the slot
+// and with every key out of line, and the key arena they are kept in
+template<usize KeyCapacity>
+void TestLongKeys() {
+  cout << endl
+       << "==================== TestLongKeys<" << KeyCapacity
+       << "> ====================" << endl;
+
+  typedef unsigned T;
+  const unsigned count = 300;
+  const vector<string> ids = MakeIDs(count);
+  const string tail = "-a-key-well-past-32-characters-long";
+
+  // every third key is short enough for the slot
+  vector<string> keys;
+  for (unsigned i = 0; i < count; i++) {
+    keys.push_back(i % 3 ? ids[i] + tail : ids[i]);
+  }
+  cout << "Key: " << keys[1] << " (" << keys[1].size() << " characters)"
+       << endl;
+
+  try {
+    OAHashTable<T, KeyCapacity> ht(
+      typename OAHashTable<T, KeyCapacity>::OAHTConfig(7, PJWHash, NULL,
+                                                       0.75, 2.0, PACK, 0)
+    );
+
+    for (unsigned i = 0; i < count; i++) {
+      ht.insert(keys[i].c_str(), i);
+    }
+
+    unsigned right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = ht.try_find(keys[i].c_str());
+      right += value and *value == i;
+    }
+    cout << "Items: " << ht.GetStats().Count_ << ", found " << right
+         << endl;
+
+    // keys that only differ past the first 31 characters stay apart
+    const string longer = keys[1] + "-and-then-some";
+    cout << "try_find " << longer << ": "
+         << (ht.try_find(longer.c_str()) ? "found" : "nullptr") << endl;
+    cout << "try_insert " << longer << ": "
+         << StatusName(ht.try_insert(longer.c_str(), count)) << endl;
+    cout << "try_insert " << keys[1] << ": "
+         << StatusName(ht.try_insert(keys[1].c_str(), count)) << endl;
+    cout << "find " << keys[1] << ": " << ht.find(keys[1].c_str()) << endl;
+    cout << "find " << longer << ": " << ht.find(longer.c_str()) << endl;
+
+    for (unsigned i = 0; i < count; i += 2) {
+      ht.remove(keys[i].c_str());
+    }
+    right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = ht.try_find(keys[i].c_str());
+      right += i % 2 ? value and *value == i : value == nullptr;
+    }
+    cout << "After removing half: " << ht.GetStats().Count_ << " items, "
+         << right << " right" << endl;
+
+    // the keys of removed items stay in the arena until it is compacted
+    unsigned next = count;
+    for (unsigned round = 0; round < 4; round++) {
+      for (unsigned i = 1; i < count; i += 2) {
+        ht.remove(keys[i].c_str());
+        keys[i] = ids[i] + tail + "-" + to_string(next++);
+        ht.insert(keys[i].c_str(), i);
+      }
+    }
+
+    usize live = 0;
+    for (unsigned i = 1; i < count; i += 2) {
+      live += keys[i].size() >= KeyCapacity ? keys[i].size() + 1 : 0;
+    }
+    live += longer.size() + 1;
+    cout << "Arena: " << ht.arena_size() << " bytes, " << live
+         << " of them live" << endl;
+
+    ht.compact();
+    right = 0;
+    for (unsigned i = 1; i < count; i += 2) {
+      const T* value = ht.try_find(keys[i].c_str());
+      right += value and *value == i;
+    }
+    cout << "After compact: " << ht.arena_size() << " bytes, found "
+         << right << " of " << count / 2 << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestLongKeys" << endl
+         << endl;
+  }
+}
+
+// Hasher and KeyEqual that ignore the case of ASCII letters
+struct NoCaseHasher {
+  unsigned primary(const char* key, unsigned range) const {
+    return hash(key, 2166136261u) % range;
+  }
+
+  unsigned secondary(const char* key, unsigned range) const {
+    return hash(key, 0x9747B28Cu) % range;
+  }
+
+  bool has_secondary() const { return true; }
+
+  static unsigned hash(const char* key, unsigned seed) {
+    for (; *key; key++) {
+      seed ^= static_cast<unsigned char>(tolower(*key));
+      seed *= 16777619u;
+    }
+    return seed;
+  }
+};
+
+struct NoCaseEqual {
+  bool operator()(const char* left, const char* right) const {
+    for (; *left and tolower(*left) == tolower(*right); left++, right++) {
+    }
+    return tolower(*left) == tolower(*right);
+  }
+};
+
+// A table with its own Hasher and KeyEqual finds keys whatever their case,
+// with and without control bytes and stored hashes
+void TestNoCase() {
+  cout << endl
+       << "==================== TestNoCase ====================" << endl;
+
+  typedef unsigned T;
+  typedef OAHashTable<T, MAX_KEYLEN, NoCaseHasher, NoCaseEqual> Table;
+  const char* keys[] = {"Apple", "banana", "Cherry", "date", "Elder",
+                        "fig", "Grape", "honeydew", "Kiwi", "lemon",
+                        "Mango", "nectarine"};
+  const unsigned count = sizeof(keys) / sizeof(*keys);
+
+  for (unsigned option = 0; option < 3; option++) {
+    Table::OAHTConfig config(7);
+    config.DeletionPolicy_ = MARK;
+    config.ControlBytes_ = option == 1;
+    config.StoreHashes_ = option == 2;
+
+    const char* names[] = {"Plain", "ControlBytes_", "StoreHashes_"};
+    cout << endl << names[option] << ":" << endl;
+
+    try {
+      Table ht(config);
+      for (unsigned i = 0; i < count; i++) {
+        ht.insert(keys[i], i);
+      }
+
+      cout << "find APPLE: " << ht.find("APPLE") << endl;
+      cout << "find Honeydew: " << ht.find("Honeydew") << endl;
+      cout << "try_insert BANANA: " << StatusName(ht.try_insert("BANANA", 0))
+           << endl;
+      cout << "try_remove CHERRY: " << StatusName(ht.try_remove("CHERRY"))
+           << endl;
+      cout << "try_find cherry: "
+           << (ht.try_find("cherry") ? "found" : "nullptr") << endl;
+      cout << "try_insert cherry: " << StatusName(ht.try_insert("cherry", 2))
+           << endl;
+
+      unsigned right = 0;
+      for (unsigned i = 0; i < count; i++) {
+        string upper = keys[i];
+        for (char& c : upper) {
+          c = static_cast<char>(toupper(c));
+        }
+        const T* value = ht.try_find(upper.c_str());
+        right += value and *value == i;
+      }
+      cout << "Found " << right << " of " << count << " in upper case"
+           << ", TableSize: " << ht.GetStats().TableSize_ << endl;
+    } catch (OAHashTableException& e) {
+      cout << endl
+           << "errno: " << e.code() << ", " << e.what() << endl
+           << endl;
+    } catch (...) {
+      cout << endl
+           << "**** Something bad happened in TestNoCase" << endl
+           << endl;
+    }
+  }
+}
+
+// Data that counts its copies
+struct Counted {
+  Counted() = default;
+
+  explicit Counted(unsigned value): value{value} {}
+
+  Counted(const Counted& from): value{from.value} { Copies++; }
+
+  Counted(Counted&& from): value{from.value} { from.value = 0; }
+
+  Counted& operator=(const Counted& from) {
+    value = from.value;
+    Copies++;
+    return *this;
+  }
+
+  Counted& operator=(Counted&& from) {
+    value = from.value;
+    from.value = 0;
+    return *this;
+  }
+
+  static unsigned Copies;
+
+  unsigned value{0}; // 0 once moved from
+};
+
+unsigned Counted::Copies = 0;
+
+// Moved in data is never copied, by growth, Robin Hood displacement or PACK
+// reinsertion, and a duplicate key leaves it where it was
+void TestMoveValues() {
+  cout << endl
+       << "==================== TestMoveValues ====================" << endl;
+
+  const unsigned count = 200;
+  const vector<string> ids = MakeIDs(count);
+
+  for (unsigned option = 0; option < 2; option++) {
+    const char* names[] = {"PACK", "Robin Hood"};
+    cout << endl << names[option] << ":" << endl;
+
+    try {
+      typedef Counted T;
+      OAHashTable<T>::OAHTConfig config(7, FastHash, NULL, 0.75, 2.0, PACK,
+                                        0);
+      config.RobinHood_ = option == 1;
+      OAHashTable<T> ht(config);
+      Counted::Copies = 0;
+
+      for (unsigned i = 0; i < count; i++) {
+        if (i % 2) {
+          ht.insert(ids[i].c_str(), Counted(i + 1));
+        } else {
+          ht.emplace(ids[i].c_str(), i + 1);
+        }
+      }
+      for (unsigned i = 0; i < count; i += 4) {
+        ht.remove(ids[i].c_str());
+      }
+
+      Counted kept(1000);
+      cout << "try_emplace " << ids[1] << ": "
+           << StatusName(ht.try_emplace(ids[1].c_str(), std::move(kept)))
+           << ", value left: " << kept.value << endl;
+      cout << "try_insert " << ids[3] << ": "
+           << StatusName(ht.try_insert(ids[3].c_str(), std::move(kept)))
+           << ", value left: " << kept.value << endl;
+
+      unsigned right = 0;
+      for (unsigned i = 0; i < count; i++) {
+        const T* value = ht.try_find(ids[i].c_str());
+        right += i % 4 ? value and value->value == i + 1 : value == nullptr;
+      }
+      cout << "Items: " << ht.GetStats().Count_ << ", " << right
+           << " right, expansions: " << ht.GetStats().Expansions_
+           << ", copies: " << Counted::Copies << endl;
+    } catch (OAHashTableException& e) {
+      cout << endl
+           << "errno: " << e.code() << ", " << e.what() << endl
+           << endl;
+    } catch (...) {
+      cout << endl
+           << "**** Something bad happened in TestMoveValues" << endl
+           << endl;
+    }
+  }
+
+  // data that cannot be copied at all
+  try {
+    typedef unique_ptr<unsigned> T;
+    OAHashTable<T>::OAHTConfig config(7, FastHash, NULL, 0.75, 2.0, PACK, 0);
+    config.RobinHood_ = true;
+    OAHashTable<T> ht(config);
+
+    for (unsigned i = 0; i < count; i++) {
+      ht.insert(ids[i].c_str(), T(new unsigned(i)));
+    }
+    ht.remove(ids[0].c_str());
+
+    T kept(new unsigned(1000));
+    cout << endl
+         << "unique_ptr try_emplace " << ids[1] << ": "
+         << StatusName(ht.try_emplace(ids[1].c_str(), std::move(kept)))
+         << ", value left: " << (kept ? *kept : 0) << endl;
+    cout << "find " << ids[5] << ": " << **ht.try_find(ids[5].c_str())
+         << ", items: " << ht.GetStats().Count_ << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestMoveValues" << endl
+         << endl;
+  }
+}
+
+// Bytes the slot and control arrays of TestHugePages hold right now
+long long HugeBytes = 0;
+unsigned HugeAllocs = 0;
+
+void* CountingHugeAlloc(size_t bytes) {
+  HugeBytes += static_cast<long long>(bytes);
+  HugeAllocs++;
+  return HugePageAlloc(bytes);
+}
+
+void CountingHugeFree(void* memory, size_t bytes) {
+  HugeBytes -= static_cast<long long>(bytes);
+  HugePageFree(memory, bytes);
+}
+
+// Tables whose arrays come from HugePageAlloc, big enough to be mapped on
+// huge pages, built, grown, built in parallel and moved
+void TestHugePages() {
+  cout << endl
+       << "==================== TestHugePages ====================" << endl;
+
+  typedef unsigned T;
+  const unsigned count = 70000;
+  const vector<string> ids = MakeIDs(count);
+  vector<const char*> keys;
+  vector<T> values;
+  for (unsigned i = 0; i < count; i++) {
+    keys.push_back(ids[i].c_str());
+    values.push_back(i);
+  }
+
+  OAHashTable<T>::OAHTConfig config(7, FastHash, NULL, 0.5, 2.0, MARK, 0);
+  config.ControlBytes_ = true;
+  config.StoreHashes_ = true;
+  config.AllocFunc_ = CountingHugeAlloc;
+  config.DeallocFunc_ = CountingHugeFree;
+
+  try {
+    OAHashTable<T> grown(config);
+    for (unsigned i = 0; i < count; i++) {
+      grown.insert(keys[i], i);
+    }
+
+    unsigned right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = grown.try_find(keys[i]);
+      right += value and *value == i;
+    }
+    const bool huge = HugeBytes >= static_cast<long long>(HUGE_PAGE_SIZE);
+    cout << "grown: " << grown.GetStats().Count_ << " items, " << right
+         << " found, " << grown.GetStats().TableSize_ << " slots, "
+         << "over 2 MB: " << huge << endl;
+
+    OAHashTable<T> built{
+      OAHashTable<T>::build_parallel(keys.data(), values.data(), count,
+                                     config, 4)
+    };
+    OAHashTable<T> moved{std::move(built)};
+    grown = std::move(moved);
+
+    right = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const T* value = grown.try_find(keys[i]);
+      right += value and *value == i;
+    }
+    cout << "built and moved: " << grown.GetStats().Count_ << " items, "
+         << right << " found" << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestHugePages" << endl
+         << endl;
+  }
+  cout << "bytes left: " << HugeBytes << endl;
+
+  // without a DEALLOCFUNC the table keeps to new and delete
+  HugeAllocs = 0;
+  config.DeallocFunc_ = nullptr;
+
+  try {
+    OAHashTable<T> ht(config);
+    for (unsigned i = 0; i < 1000; i++) {
+      ht.insert(keys[i], i);
+    }
+    cout << "AllocFunc_ alone: " << ht.GetStats().Count_ << " items, "
+         << HugeAllocs << " allocations through it" << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestHugePages" << endl
+         << endl;
+  }
+}
+
+// Copies find their long keys in an arena of their own, whatever happens to
+// the table they came from, also halfway through a migration
+void TestCopy() {
+  cout << endl << "==================== TestCopy ====================" << endl;
+
+  typedef unsigned T;
+  const unsigned count = 500;
+  const vector<string> ids = MakeIDs(count);
+  const string tail = "-a-key-well-past-32-characters-long";
+
+  vector<string> keys;
+  for (unsigned i = 0; i < count; i++) {
+    keys.push_back(i % 3 ? ids[i] + tail : ids[i]);
+  }
+
+  for (unsigned option = 0; option < 2; option++) {
+    const char* names[] = {"Slots only", "Control bytes, hashes, migration"};
+    cout << endl << names[option] << ":" << endl;
+
+    try {
+      OAHashTable<T, 8>::OAHTConfig config(7, PJWHash, NULL, 0.75, 2.0,
+                                           PACK, 0);
+      config.ControlBytes_ = option == 1;
+      config.StoreHashes_ = option == 1;
+      config.MigrationBatch_ = option == 1 ? 8 : 0;
+
+      OAHashTable<T, 8> ht(config);
+      for (unsigned i = 0; i < count; i++) {
+        ht.insert(keys[i].c_str(), i);
+      }
+
+      OAHashTable<T, 8> copy{ht};
+      OAHashTable<T, 8> assigned(config);
+      assigned.insert(keys[0].c_str(), count);
+      assigned = copy;
+
+      ht.clear();
+      for (unsigned i = 0; i < count; i += 2) {
+        copy.remove(keys[i].c_str());
+      }
+
+      unsigned right = 0;
+      unsigned assigned_right = 0;
+      for (unsigned i = 0; i < count; i++) {
+        const T* value = copy.try_find(keys[i].c_str());
+        right += i % 2 ? value and *value == i : value == nullptr;
+        value = assigned.try_find(keys[i].c_str());
+        assigned_right += value and *value == i;
+      }
+      cout << "original: " << ht.GetStats().Count_ << " items" << endl;
+      cout << "copy: " << copy.GetStats().Count_ << " items, " << right
+           << " right" << endl;
+      cout << "assigned: " << assigned.GetStats().Count_ << " items, "
+           << assigned_right << " right" << endl;
+    } catch (OAHashTableException& e) {
+      cout << endl
+           << "errno: " << e.code() << ", " << e.what() << endl
+           << endl;
+    } catch (...) {
+      cout << endl
+           << "**** Something bad happened in TestCopy" << endl
+           << endl;
+    }
+  }
+}
+
+// Every key on one of four neighbouring homes, so they all share one cluster
+unsigned FourHomes(const char* key, unsigned) { return SimpleHash(key, 4); }
+
+struct CountingEqual {
+  bool operator()(const char* left, const char* right) const {
+    Compares++;
+    return strcmp(left, right) == 0;
+  }
+
+  static unsigned Compares;
+};
+
+unsigned CountingEqual::Compares = 0;
+
+// Keys from other homes that probe through a cluster are rejected on their
+// control byte without comparing keys, whether a whole group of control
+// bytes is matched at once (linear probing) or one byte per probe (double
+// hashing). Build with OAHT_NO_SIMD for the portable group match
+void TestControlBytes() {
+  cout << endl
+       << "==================== TestControlBytes ===================="
+       << endl;
+
+  typedef unsigned T;
+  typedef OAHashTable<T, MAX_KEYLEN, OAHTFunctionHasher, CountingEqual> Table;
+  const unsigned count = 200;
+  const vector<string> ids = MakeIDs(2 * count);
+
+  for (unsigned option = 0; option < 3; option++) {
+    const char* names[] = {"Slots only", "Control groups",
+                           "Control bytes, double hashing"};
+    cout << endl << names[option] << ":" << endl;
+
+    try {
+      Table::OAHTConfig config(1024, FourHomes, NULL, 0.75, 2.0, MARK, 0);
+      config.ControlBytes_ = option > 0;
+      config.SecondaryHashFunc_ = option == 2 ? SimpleHash : NULL;
+      Table ht(config);
+
+      for (unsigned i = 0; i < count; i++) {
+        ht.insert(ids[i].c_str(), i);
+      }
+
+      CountingEqual::Compares = 0;
+      unsigned right = 0;
+      for (unsigned i = 0; i < count; i++) {
+        const T* value = ht.try_find(ids[i].c_str());
+        right += value and *value == i;
+      }
+      cout << "Found " << right << ", keys compared: "
+           << CountingEqual::Compares << endl;
+
+      CountingEqual::Compares = 0;
+      unsigned missing = 0;
+      for (unsigned i = count; i < 2 * count; i++) {
+        missing += ht.try_find(ids[i].c_str()) == nullptr;
+      }
+      cout << "Missing " << missing << ", keys compared: "
+           << CountingEqual::Compares << endl;
+    } catch (OAHashTableException& e) {
+      cout << endl
+           << "errno: " << e.code() << ", " << e.what() << endl
+           << endl;
+    } catch (...) {
+      cout << endl
+           << "**** Something bad happened in TestControlBytes" << endl
+           << endl;
+    }
+  }
+}
+
+// POWER_OF_TWO tables round every capacity up to a power of two, and their
+// probe sequences reach every slot: linear probing, and double hashing with
+// the stride made odd
+void TestPowerOfTwo() {
+  cout << endl
+       << "==================== TestPowerOfTwo ====================" << endl;
+
+  typedef Person* T;
+  for (unsigned option = 0; option < 2; option++) {
+    const char* names[] = {"Linear probing", "Double hashing"};
+    cout << endl << names[option] << ":" << endl;
+
+    try {
+      OAHashTable<T>::OAHTConfig config(5, PJWHash, NULL, 0.75, 2.0, MARK,
+                                        0);
+      config.SecondaryHashFunc_ = option == 1 ? RSHash : NULL;
+      config.CapacityPolicy_ = POWER_OF_TWO;
+      OAHashTable<T> ht(config);
+      cout << "Initial TableSize: " << ht.GetStats().TableSize_ << endl;
+
+      for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+        Person* person = PersonRecs[i];
+        ht.insert(person->ID, person);
+      }
+      ht.remove("106001");
+      ht.remove("115001");
+      DumpStats<T>(ht);
+
+      unsigned found = 0;
+      for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+        found += ht.try_find(PersonRecs[i]->ID) != nullptr;
+      }
+      cout << "Found " << found << " of " << NUM_PEOPLE << endl;
+    } catch (OAHashTableException& e) {
+      cout << endl
+           << "errno: " << e.code() << ", " << e.what() << endl
+           << endl;
+    } catch (...) {
+      cout << endl
+           << "**** Something bad happened in TestPowerOfTwo" << endl
+           << endl;
+    }
+  }
+
+  // every key has the same home, only odd strides fill every slot
+  cout << endl << "Constant home:" << endl;
+  try {
+    OAHashTable<T>::OAHTConfig config(8, ConstantHash, SimpleHash, 1.0, 2.0,
+                                      PACK, 0);
+    config.CapacityPolicy_ = POWER_OF_TWO;
+    OAHashTable<T> ht(config);
+
+    for (unsigned i = 0; i < 8; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestPowerOfTwo" << endl
+         << endl;
+  }
+}
+
+// An insert finds a key behind tombstones in one pass, and a new key goes
+// into the first tombstone it passed
+void TestDuplicates() {
+  cout << endl
+       << "==================== TestDuplicates ====================" << endl;
+
+  typedef Person* T;
+  OAHashTable<T> ht(
+    OAHashTable<T>::OAHTConfig(11, ConstantHash, NULL, 1.0, 2.0, MARK, 0)
+  );
+  try {
+    for (unsigned i = 0; i < 6; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+    ht.remove(PersonRecs[0]->ID);
+    ht.remove(PersonRecs[1]->ID);
+    DumpTable<T>(ht);
+    cout << "Tombstones: " << ht.GetStats().Tombstones_ << endl;
+
+    unsigned probes = ht.GetStats().Probes_;
+    cout << "try_insert " << PersonRecs[5]->ID << ": "
+         << StatusName(ht.try_insert(PersonRecs[5]->ID, PersonRecs[5]))
+         << ", probes: " << ht.GetStats().Probes_ - probes << endl;
+
+    probes = ht.GetStats().Probes_;
+    ht.insert(PersonRecs[6]->ID, PersonRecs[6]);
+    cout << "insert " << PersonRecs[6]->ID
+         << ", probes: " << ht.GetStats().Probes_ - probes << endl;
+    ht.insert(PersonRecs[1]->ID, PersonRecs[1]);
+    DumpTable<T>(ht);
+    DumpStats<T>(ht);
+    cout << "Tombstones: " << ht.GetStats().Tombstones_ << endl;
+
+    ht.insert(PersonRecs[3]->ID, PersonRecs[3]);
+  } catch (OAHashTableException& e) {
+    cout << "errno: " << e.code() << ", " << e.what() << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestDuplicates" << endl
+         << endl;
+  }
+}
+
+// FastHash spreads keys evenly over prime and power of two table sizes,
+// where the byte at a time hash functions above only manage prime ones, and
+// its seed and every byte of a key change the hash. It is the primary hash
+// of a config that names none
+void TestFastHash() {
+  cout << endl
+       << "==================== TestFastHash ====================" << endl;
+
+  const unsigned count = 20000;
+  const vector<string> ids = MakeIDs(count);
+  const unsigned sizes[] = {1009, 1024};
+  const HASHFUNCS funcs[] = {SIMPLE, RS, UNIVERSAL, PJW, FAST};
+
+  for (const unsigned size : sizes) {
+    cout << endl
+         << count << " keys, " << size << " buckets (" << count / size
+         << " each on average):" << endl;
+
+    for (const HASHFUNCS func : funcs) {
+      vector<unsigned> buckets(size);
+      for (unsigned i = 0; i < count; i++) {
+        buckets[HashingFuncs[func].Fn(ids[i].c_str(), size)]++;
+      }
+
+      cout << setw(16) << left << HashingFuncs[func].Name << right
+           << " fullest: " << setw(5)
+           << *max_element(buckets.begin(), buckets.end())
+           << ", empty: " << setw(5)
+           << count_if(buckets.begin(), buckets.end(),
+                       [](unsigned n) { return n == 0; })
+           << endl;
+    }
+  }
+
+  // each of the 64 bits is set for about half of the keys, whatever the seed
+  cout << endl;
+  const uint64_t seeds[] = {0, 1, 0xA0761D6478BD642Full};
+  for (const uint64_t seed : seeds) {
+    unsigned set[64] = {};
+    unsigned same = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+      const uint64_t hash = FastHash64(ids[i].c_str(), ids[i].size(), seed);
+      same += hash == FastHash64(ids[i].c_str(), ids[i].size());
+
+      for (unsigned bit = 0; bit < 64; bit++) {
+        set[bit] += (hash >> bit) & 1;
+      }
+    }
+
+    const unsigned fewest = *min_element(set, set + 64);
+    const unsigned most = *max_element(set, set + 64);
+    cout << "seed " << seed << ": every bit set for 48-52% of the keys: "
+         << (fewest > count * 48 / 100 and most < count * 52 / 100 ? "yes"
+                                                                   : "no")
+         << ", hashes equal to seed 0: " << same << endl;
+  }
+
+  // one more byte, or one byte changed, makes another hash at every length
+  // FastHash64 handles differently (up to 16, up to 32, longer)
+  string key;
+  vector<uint64_t> hashes;
+  for (unsigned length = 0; length <= 40; length++) {
+    hashes.push_back(FastHash64(key.c_str(), key.size()));
+    string changed = key + 'b';
+    changed[0] = 'b';
+    hashes.push_back(FastHash64(changed.c_str(), changed.size()));
+    key += 'a';
+  }
+  sort(hashes.begin(), hashes.end());
+  cout << "Different hashes of keys up to 41 bytes: "
+       << unique(hashes.begin(), hashes.end()) - hashes.begin() << " of "
+       << hashes.size() << endl;
+
+  typedef Person* T;
+  try {
+    OAHashTable<T> ht(OAHashTable<T>::OAHTConfig(7));
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+
+    unsigned found = 0;
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      found += ht.try_find(PersonRecs[i]->ID) != nullptr;
+    }
+    cout << "Default primary hash is FastHash: "
+         << (ht.GetStats().PrimaryHashFunc_ == FastHash ? "yes" : "no")
+         << ", found " << found << " of " << NUM_PEOPLE << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestFastHash" << endl
+         << endl;
+  }
+}
+
+unsigned ClientHashes = 0;
+unsigned Digests = 0;
+
+unsigned CountingHash(const char* key, unsigned size) {
+  ClientHashes++;
+  return SimpleHash(key, size);
+}
+
+uint64_t CountingDigest(const char* key) {
+  Digests++;
+  return FastDigest(key);
+}
+
+// Every key on the same home, each with the stride from its low half
+uint64_t SameHomeDigest(const char* key) {
+  return uint64_t{3} << 32 | (FastDigest(key) & 0xFFFFFFFF);
+}
+
+// With a DigestFunc_ each operation hashes its key once, and the client hash
+// functions are never called. The stride from the low half is never 0 and
+// reaches every slot, for prime and power of two capacities
+void TestDigest() {
+  cout << endl
+       << "==================== TestDigest ====================" << endl;
+
+  typedef Person* T;
+  try {
+    OAHashTable<T>::OAHTConfig config(7, CountingHash, CountingHash, 0.75,
+                                      2.0, MARK, 0);
+    config.DigestFunc_ = CountingDigest;
+    OAHashTable<T> ht(config);
+    ClientHashes = 0;
+    Digests = 0;
+
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      Person* person = PersonRecs[i];
+      ht.insert(person->ID, person);
+    }
+    const unsigned inserted = Digests;
+
+    unsigned found = 0;
+    for (unsigned i = 0; i < NUM_PEOPLE; i++) {
+      found += ht.try_find(PersonRecs[i]->ID) != nullptr;
+    }
+    ht.remove("106001");
+    DumpStats<T>(ht);
+    cout << "Found " << found << ", digests: " << inserted << " inserting, "
+         << Digests - inserted << " finding and removing, client hashes: "
+         << ClientHashes << endl;
+  } catch (OAHashTableException& e) {
+    cout << endl << "errno: " << e.code() << ", " << e.what() << endl << endl;
+  } catch (...) {
+    cout << endl
+         << "**** Something bad happened in TestDigest" << endl
+         << endl;
+  }
+
+  for (unsigned option = 0; option < 2; option++) {
+    const char* names[] = {"PRIME", "POWER_OF_TWO"};
+    cout << endl << "Same home, " << names[option] << ":" << endl;
+
+    try {
+      OAHashTable<T>::OAHTConfig config(option == 0 ? 11 : 8, NULL, NULL,
+                                        1.0, 2.0, PACK, 0);
+      config.DigestFunc_ = SameHomeDigest;
+      config.CapacityPolicy_ = option == 0 ? PRIME : POWER_OF_TWO;
+      OAHashTable<T> ht(config);
+
+      for (unsigned i = 0; i < ht.GetStats().TableSize_; i++) {
+        Person* person = PersonRecs[i];
+        ht.insert(person->ID, person);
+      }
+      DumpStats<T>(ht);
+    } catch (OAHashTableException& e) {
+      cout << endl
+           << "errno: " << e.code() << ", " << e.what() << endl
+           << endl;
+    } catch (...) {
+      cout << endl
+           << "**** Something bad happened in TestDigest" << endl
+           << endl;
+    }
+  }
+}
+
 void testhash() {
   unsigned (*hf)(const char* Key, unsigned TableSize) = PJWHash;
   unsigned size = 13;
@@ -1030,6 +2724,74 @@ int main(int argc, char** argv) {
       TestDoubleHashing(&HashingFuncs[PJW], &HashingFuncs[SIMPLE]);
       break;
 
+      // ****************** Deletion policies, growth and options
+      // ***********************
+    case 14: TestBackshift(); break;
+
+    case 15: TestRobinHood(); break;
+
+    case 16: TestPurge(); break;
+
+    case 17: TestMigration(); break;
+
+    case 18: TestReserveRehash(); break;
+
+    case 19: TestTryOperations(); break;
+
+    case 20: TestFindMany(); break;
+
+    case 21:
+      TestGrowThreads();
+      TestBuildParallel();
+      break;
+
+      // ****************** Other tables
+      // ***********************
+    case 22: TestConcurrent(); break;
+
+    case 23: TestRcu(); break;
+
+    case 24: TestLockFree(&HashingFuncs[FAST]); break;
+
+    case 25: TestCuckoo(&HashingFuncs[SIMPLE], &HashingFuncs[NONE]); break;
+
+    case 26:
+      TestCuckoo(&HashingFuncs[CONSTANT], &HashingFuncs[CONSTANT]);
+      break;
+
+    case 27: TestRcuHashFunc(&HashingFuncs[PJW]); break;
+
+    case 28: TestLockFree(&HashingFuncs[PJW]); break;
+
+    case 29: TestCuckooLoad(&HashingFuncs[PJW]); break;
+
+    case 30: TestCuckooLoad(&HashingFuncs[CONSTANT]); break;
+
+    case 31:
+      TestLongKeys<8>();
+      TestLongKeys<1>();
+      break;
+
+    case 32: TestNoCase(); break;
+
+    case 33: TestMoveValues(); break;
+
+    case 34: TestHugePages(); break;
+
+    case 35: TestCopy(); break;
+
+    case 36: TestLockFreeDuplicates(); break;
+
+    case 37: TestControlBytes(); break;
+
+    case 38: TestPowerOfTwo(); break;
+
+    case 39: TestDuplicates(); break;
+
+    case 40: TestFastHash(); break;
+
+    case 41: TestDigest(); break;
+
     default:
       TestALot(&HashingFuncs[SIMPLE], &HashingFuncs[NONE]);
       TestSimpleGrow1();
@@ -1045,6 +2807,37 @@ int main(int argc, char** argv) {
       TestSimpleMarkPack(&HashingFuncs[SIMPLE], &HashingFuncs[NONE], MARK);
       TestSimpleMarkPack(&HashingFuncs[SIMPLE], &HashingFuncs[PJW], MARK);
       TestDoubleHashing(&HashingFuncs[PJW], &HashingFuncs[SIMPLE]);
+
+      TestBackshift();
+      TestRobinHood();
+      TestPurge();
+      TestMigration();
+      TestReserveRehash();
+      TestControlBytes();
+      TestPowerOfTwo();
+      TestDuplicates();
+      TestLongKeys<8>();
+      TestLongKeys<1>();
+      TestNoCase();
+      TestCopy();
+      TestFastHash();
+      TestDigest();
+      TestMoveValues();
+      TestTryOperations();
+      TestFindMany();
+      TestConcurrent();
+      TestRcu();
+      TestRcuHashFunc(&HashingFuncs[PJW]);
+      TestLockFree(&HashingFuncs[FAST]);
+      TestLockFree(&HashingFuncs[PJW]);
+      TestLockFreeDuplicates();
+      TestGrowThreads();
+      TestBuildParallel();
+      TestHugePages();
+      TestCuckoo(&HashingFuncs[SIMPLE], &HashingFuncs[NONE]);
+      TestCuckoo(&HashingFuncs[CONSTANT], &HashingFuncs[CONSTANT]);
+      TestCuckooLoad(&HashingFuncs[PJW]);
+      TestCuckooLoad(&HashingFuncs[CONSTANT]);
       break;
   }
 